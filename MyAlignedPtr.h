@@ -0,0 +1,203 @@
+#ifndef _MYALIGNEDPTR_H_
+#define _MYALIGNEDPTR_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <sys/mman.h>
+
+#include "MySmartPtr.h"
+
+namespace MyTR1 {
+
+	const size_t _Huge_Page_Size = size_t(2) << 20;
+
+	template <typename _T>
+	void _Destroy_Array(_T* _ptr, size_t _count) noexcept {
+		if (!is_trivially_destructible<_T>::value)
+			while (_count)
+				_ptr[--_count].~_T();
+	}
+
+	//value-initializes _count elements in raw memory, undoing the work on failure
+	template <typename _T>
+	void _Construct_Array(_T* _ptr, size_t _count) {
+		size_t _done = 0;
+		try {
+			for (; _done < _count; ++_done)
+				::new (static_cast<void*>(_ptr + _done)) _T();
+		}
+		catch (...) {
+			_Destroy_Array(_ptr, _done);
+			throw;
+		}
+	}
+
+	template <typename _T>
+	size_t _Array_Bytes(size_t _count) {
+		if (_count > size_t(-1) / sizeof(_T))
+			throw ::std::bad_alloc();
+		return _count * sizeof(_T);
+	}
+
+	inline size_t _Round_Up(size_t _bytes, size_t _align) {
+		if (_bytes > size_t(-1) - (_align - 1))
+			throw ::std::bad_alloc();
+		return (_bytes + _align - 1) & ~(_align - 1);
+	}
+
+	// the element count doubles as what the deleter needs to free the block,
+	// so unique_ptr stays two words and operator[] can check indices
+	template <typename _T>
+	class aligned_array_delete {
+	public:
+		constexpr aligned_array_delete() noexcept
+			: _myCount(0)
+		{
+		}
+
+		explicit aligned_array_delete(size_t _count) noexcept
+			: _myCount(_count)
+		{
+		}
+
+		void operator()(_T* _ptr) const noexcept {
+			if (_ptr) {
+				_Destroy_Array(_ptr, _myCount);
+				::std::free(_ptr);
+			}
+		}
+
+		size_t size() const noexcept {
+			return _myCount;
+		}
+
+	private:
+		size_t _myCount;
+	};
+
+	template <typename _T>
+	class hugepage_array_delete {
+	public:
+		constexpr hugepage_array_delete() noexcept
+			: _myCount(0)
+		{
+		}
+
+		explicit hugepage_array_delete(size_t _count) noexcept
+			: _myCount(_count)
+		{
+		}
+
+		void operator()(_T* _ptr) const noexcept {
+			if (_ptr) {
+				_Destroy_Array(_ptr, _myCount);
+				::munmap(_ptr, _Mapping_Size(_myCount));
+			}
+		}
+
+		size_t size() const noexcept {
+			return _myCount;
+		}
+
+		static size_t _Mapping_Size(size_t _count) {
+			return _Round_Up(_Array_Bytes<_T>(_count), _Huge_Page_Size);
+		}
+
+	private:
+		size_t _myCount;
+	};
+
+	template <typename _T>
+	struct _Unique_Aligned_Array
+	{
+	};
+
+	template <typename _T>
+	struct _Unique_Aligned_Array<_T[]> {
+		typedef unique_ptr<_T[], aligned_array_delete<_T>> _Aligned;
+		typedef unique_ptr<_T[], hugepage_array_delete<_T>> _Huge;
+	};
+
+	static_assert(sizeof(_Unique_Aligned_Array<char[]>::_Aligned) == 2 * sizeof(void*)
+		&& sizeof(_Unique_Aligned_Array<char[]>::_Huge) == 2 * sizeof(void*),
+		"array deleters must keep unique_ptr at two words");
+
+	// _count value-initialized elements on an _align-byte boundary, e.g. 64 for
+	// AVX-512 loads. _align must be a power of two
+	template <typename _T>
+	typename _Unique_Aligned_Array<_T>::_Aligned make_unique_aligned(size_t _count, size_t _align) {
+		typedef typename remove_extent<_T>::type _Elem;
+		typedef typename _Unique_Aligned_Array<_T>::_Aligned _Ret;
+
+		assert(_align && (_align & (_align - 1)) == 0);
+		if (_align < alignof(_Elem))
+			_align = alignof(_Elem);
+		if (_count == 0)
+			return _Ret();
+
+		//aligned_alloc wants the size to be a multiple of the alignment
+		size_t _bytes = _Round_Up(_Array_Bytes<_Elem>(_count), _align);
+		_Elem* _ptr = static_cast<_Elem*>(::std::aligned_alloc(_align, _bytes));
+		if (!_ptr)
+			throw ::std::bad_alloc();
+		try {
+			_Construct_Array(_ptr, _count);
+		}
+		catch (...) {
+			::std::free(_ptr);
+			throw;
+		}
+		return _Ret(_ptr, aligned_array_delete<_Elem>(_count));
+	}
+
+	// _count value-initialized elements in anonymous memory aligned to 2 MiB
+	// and advised for transparent huge pages, to widen TLB reach over large
+	// buffers. trivial element types are left to the zero-filled pages, so
+	// memory is only committed as it is touched
+	template <typename _T>
+	typename _Unique_Aligned_Array<_T>::_Huge make_unique_hugepage(size_t _count) {
+		typedef typename remove_extent<_T>::type _Elem;
+		typedef typename _Unique_Aligned_Array<_T>::_Huge _Ret;
+
+		static_assert(alignof(_Elem) <= _Huge_Page_Size, "element alignment beyond a huge page");
+		if (_count == 0)
+			return _Ret();
+
+		//mmap only guarantees small-page alignment, so map one huge page more
+		//than needed and trim both ends down to an aligned range
+		size_t _len = hugepage_array_delete<_Elem>::_Mapping_Size(_count);
+		size_t _span = _Round_Up(_len + _Huge_Page_Size, _Huge_Page_Size);
+		void* _addr = ::mmap(nullptr, _span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (_addr == MAP_FAILED)
+			throw ::std::bad_alloc();
+
+		::std::uintptr_t _base = reinterpret_cast<::std::uintptr_t>(_addr);
+		::std::uintptr_t _start = (_base + _Huge_Page_Size - 1) & ~::std::uintptr_t(_Huge_Page_Size - 1);
+		if (_start != _base)
+			::munmap(_addr, _start - _base);
+		if (_base + _span != _start + _len)
+			::munmap(reinterpret_cast<void*>(_start + _len), _base + _span - (_start + _len));
+
+		_Elem* _ptr = reinterpret_cast<_Elem*>(_start);
+#ifdef MADV_HUGEPAGE
+		//only advice, the buffer works either way
+		::madvise(_ptr, _len, MADV_HUGEPAGE);
+#endif
+		if (!is_trivially_default_constructible<_Elem>::value) {
+			try {
+				_Construct_Array(_ptr, _count);
+			}
+			catch (...) {
+				::munmap(_ptr, _len);
+				throw;
+			}
+		}
+		return _Ret(_ptr, hugepage_array_delete<_Elem>(_count));
+	}
+}
+
+#endif
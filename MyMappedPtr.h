@@ -0,0 +1,486 @@
+#ifndef _MYMAPPEDPTR_H_
+#define _MYMAPPEDPTR_H_
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MySmartPtr.h"
+
+namespace MyTR1 {
+
+//*********************************************** offset_ptr **********************************************
+
+	// a pointer stored as the distance from its own address, so that it stays
+	// valid in every process mapping the same segment, wherever the mapping lands
+	template <typename _T>
+	class offset_ptr {
+		template <typename _Tx>
+		friend class offset_ptr;
+
+	public:
+		typedef _T element_type;
+
+		offset_ptr() noexcept
+			: _myOff(_Null)
+		{
+		}
+
+		offset_ptr(::std::nullptr_t) noexcept
+			: _myOff(_Null)
+		{
+		}
+
+		offset_ptr(_T* _rawPtr) noexcept
+		{
+			_Set(_rawPtr);
+		}
+
+		offset_ptr(const offset_ptr& _other) noexcept
+		{
+			_Set(_other.get());
+		}
+
+		template <typename _U>
+		offset_ptr(const offset_ptr<_U>& _other) noexcept
+		{
+			_Set(_other.get());
+		}
+
+		offset_ptr& operator=(const offset_ptr& _other) noexcept {
+			_Set(_other.get());
+			return *this;
+		}
+
+		offset_ptr& operator=(_T* _rawPtr) noexcept {
+			_Set(_rawPtr);
+			return *this;
+		}
+
+		_T* get() const noexcept {
+			if (_myOff == _Null)
+				return nullptr;
+			return reinterpret_cast<_T*>(reinterpret_cast<::std::uintptr_t>(this) + _myOff);
+		}
+
+		_T* operator->() const noexcept {
+			return get();
+		}
+
+		explicit operator bool() const noexcept {
+			return (_myOff != _Null);
+		}
+
+	private:
+		//an offset of 0 would point the offset_ptr at itself, 1 can never be a valid distance
+		static constexpr ::std::ptrdiff_t _Null = 1;
+
+		void _Set(_T* _rawPtr) noexcept {
+			if (_rawPtr)
+				_myOff = static_cast<::std::ptrdiff_t>(
+					reinterpret_cast<::std::uintptr_t>(_rawPtr) - reinterpret_cast<::std::uintptr_t>(this));
+			else
+				_myOff = _Null;
+		}
+
+		::std::ptrdiff_t _myOff;
+	};
+//*********************************************************************************************************
+
+//********************************************* mapped segment ********************************************
+
+	static_assert(::std::atomic<unsigned long>::is_always_lock_free,
+		"reference counts in a shared segment need lock-free atomics");
+
+	// lives at offset 0 of every segment. everything in here, including the
+	// allocator state, is addressed by offsets so any process can use it
+	class _Segment_Header {
+	public:
+		static constexpr unsigned long _Magic = 0x4d795452314d5047ul;
+		static constexpr size_t _Align = 16;
+
+		void _Init(size_t _size) noexcept {
+			_lock.store(0);
+			_mySize = _size;
+			_top = _Round(sizeof(_Segment_Header));
+			_free = 0;
+			_root = _Null_Root;
+			_magic.store(_Magic, ::std::memory_order_release);
+		}
+
+		bool _Ready() const noexcept {
+			return _magic.load(::std::memory_order_acquire) == _Magic;
+		}
+
+		size_t _Size() const noexcept {
+			return _mySize;
+		}
+
+		// the smallest segment that holds the header, where allocation starts
+		static size_t _Min_Size() noexcept {
+			return _Round(sizeof(_Segment_Header));
+		}
+
+		void* _Root_Slot() noexcept {
+			return &_root;
+		}
+
+		void* _Allocate(size_t _bytes) {
+			if (_bytes > size_t(-1) - (_Align - 1) - sizeof(_Block))
+				throw ::std::bad_alloc();
+			size_t _need = _Round(_bytes) + sizeof(_Block);
+			_Lock();
+
+			//first fit over the free list, no splitting or coalescing: segments are
+			//meant to hold a moderate number of large, long-lived objects
+			size_t* _link = &_free;
+			while (*_link) {
+				_Block* _blk = _At(*_link);
+				if (_blk->_size >= _need) {
+					size_t _off = *_link;
+					*_link = _blk->_next;
+					_Unlock();
+					return _Payload(_off);
+				}
+				_link = &_blk->_next;
+			}
+
+			if (_top > _mySize || _need > _mySize - _top) {
+				_Unlock();
+				throw ::std::bad_alloc();
+			}
+			size_t _off = _top;
+			_top += _need;
+			_At(_off)->_size = _need;
+			_Unlock();
+			return _Payload(_off);
+		}
+
+		void _Deallocate(void* _ptr) noexcept {
+			size_t _off = static_cast<size_t>(static_cast<char*>(_ptr) - _Base()) - sizeof(_Block);
+			_Lock();
+			_At(_off)->_next = _free;
+			_free = _off;
+			_Unlock();
+		}
+
+	private:
+		struct alignas(_Align) _Block {
+			size_t _size;
+			size_t _next;
+		};
+
+		static constexpr ::std::ptrdiff_t _Null_Root = 1;
+
+		static size_t _Round(size_t _bytes) noexcept {
+			return (_bytes + _Align - 1) & ~(_Align - 1);
+		}
+
+		char* _Base() noexcept {
+			return reinterpret_cast<char*>(this);
+		}
+
+		_Block* _At(size_t _off) noexcept {
+			return reinterpret_cast<_Block*>(_Base() + _off);
+		}
+
+		void* _Payload(size_t _off) noexcept {
+			return _Base() + _off + sizeof(_Block);
+		}
+
+		//a process dying while holding this lock leaves the segment locked
+		void _Lock() noexcept {
+			while (_lock.exchange(1, ::std::memory_order_acquire))
+				sched_yield();
+		}
+
+		void _Unlock() noexcept {
+			_lock.store(0, ::std::memory_order_release);
+		}
+
+		::std::atomic<unsigned long> _magic;
+		::std::atomic<unsigned long> _lock;
+		size_t _mySize;
+		size_t _top;
+		size_t _free;
+		//storage for the root mapped_shared_ptr, which is a single offset_ptr
+		::std::ptrdiff_t _root;
+	};
+
+	template <typename _T>
+	class mapped_shared_ptr;
+
+	// a file (typically on tmpfs, e.g. under /dev/shm) mapped shared into this
+	// process. the first process to open a path creates and formats it, later
+	// ones wait for the header and map the whole file
+	class mapped_segment {
+	public:
+		mapped_segment(const char* _path, size_t _size)
+			: _myBase(nullptr), _mySize(0), _myFd(-1)
+		{
+			bool _creator = true;
+			_myFd = ::open(_path, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (_myFd < 0 && errno == EEXIST) {
+				_creator = false;
+				_myFd = ::open(_path, O_RDWR);
+			}
+			if (_myFd < 0)
+				_Throw("open");
+
+			if (_creator) {
+				if (_size < _Segment_Header::_Min_Size()) {
+					::close(_myFd);
+					_myFd = -1;
+					::unlink(_path);
+					throw ::std::system_error(EINVAL, ::std::system_category(),
+						"mapped_segment smaller than its header");
+				}
+				if (::ftruncate(_myFd, static_cast<off_t>(_size)) != 0)
+					_Fail("ftruncate");
+				_mySize = _size;
+			}
+			else {
+				struct stat _st;
+				do {
+					if (::fstat(_myFd, &_st) != 0)
+						_Fail("fstat");
+					if (_st.st_size == 0)
+						sched_yield();
+				} while (_st.st_size == 0);
+				_mySize = static_cast<size_t>(_st.st_size);
+				if (_mySize < _Segment_Header::_Min_Size()) {
+					errno = EINVAL;
+					_Fail("mapped_segment smaller than its header");
+				}
+			}
+
+			void* _addr = ::mmap(nullptr, _mySize, PROT_READ | PROT_WRITE, MAP_SHARED, _myFd, 0);
+			if (_addr == MAP_FAILED)
+				_Fail("mmap");
+			_myBase = static_cast<char*>(_addr);
+
+			if (_creator)
+				_Header()->_Init(_mySize);
+			else
+				while (!_Header()->_Ready())
+					sched_yield();
+		}
+
+		mapped_segment(const mapped_segment&) = delete;
+
+		mapped_segment& operator=(const mapped_segment&) = delete;
+
+		~mapped_segment() {
+			if (_myBase)
+				::munmap(_myBase, _mySize);
+			if (_myFd >= 0)
+				::close(_myFd);
+		}
+
+		void* allocate(size_t _bytes) {
+			return _Header()->_Allocate(_bytes);
+		}
+
+		void deallocate(void* _ptr) noexcept {
+			_Header()->_Deallocate(_ptr);
+		}
+
+		void* base() const noexcept {
+			return _myBase;
+		}
+
+		size_t size() const noexcept {
+			return _mySize;
+		}
+
+		// a well-known slot every process can reach. it is not synchronized, and
+		// all processes must agree on _T
+		template <typename _T>
+		mapped_shared_ptr<_T>& root() noexcept {
+			return *static_cast<mapped_shared_ptr<_T>*>(_Header()->_Root_Slot());
+		}
+
+		_Segment_Header* _Header() const noexcept {
+			return reinterpret_cast<_Segment_Header*>(_myBase);
+		}
+
+	private:
+		[[noreturn]] static void _Throw(const char* _what) {
+			throw ::std::system_error(errno, ::std::system_category(), _what);
+		}
+
+		[[noreturn]] void _Fail(const char* _what) {
+			int _err = errno;
+			::close(_myFd);
+			_myFd = -1;
+			errno = _err;
+			_Throw(_what);
+		}
+
+		char* _myBase;
+		size_t _mySize;
+		int _myFd;
+	};
+//*********************************************************************************************************
+
+//******************************************* mapped_shared_ptr *******************************************
+
+	// control block and object in one segment allocation. there is no vtable,
+	// since a vptr means nothing in another process: the owning pointer type
+	// knows _T and destroys it directly
+	template <typename _T>
+	class Mapped_Ref_Count {
+	public:
+		template <typename... _Args>
+		Mapped_Ref_Count(_Segment_Header* _seg, _Args&&... _args)
+			: _use(1), _mySeg(_seg), _myObj(::std::forward<_Args>(_args)...)
+		{
+		}
+
+		void _Increment() noexcept {
+			_use.fetch_add(1, ::std::memory_order_relaxed);
+		}
+
+		void _Decrement() noexcept {
+			if (_use.fetch_sub(1, ::std::memory_order_acq_rel) == 1) {
+				_Segment_Header* _seg = _mySeg.get();
+				this->~Mapped_Ref_Count();
+				_seg->_Deallocate(this);
+			}
+		}
+
+		unsigned long _Get_Use_Count() const noexcept {
+			return _use.load();
+		}
+
+		_T* _Getptr() noexcept {
+			return &_myObj;
+		}
+
+	private:
+		::std::atomic<unsigned long> _use;
+		offset_ptr<_Segment_Header> _mySeg;
+		_T _myObj;
+	};
+
+	// shared ownership of an object living in a mapped_segment. it may itself be
+	// stored inside the segment (in another mapped object, or in root()) to hand
+	// the object to other processes without copying it
+	template <typename _T>
+	class mapped_shared_ptr {
+		template <typename _Tx, typename... _Args>
+		friend mapped_shared_ptr<_Tx> make_mapped_shared(mapped_segment& _seg, _Args&&... _args);
+
+	public:
+		typedef _T element_type;
+
+		mapped_shared_ptr() noexcept
+			: _myRefC(nullptr)
+		{
+		}
+
+		mapped_shared_ptr(::std::nullptr_t) noexcept
+			: _myRefC(nullptr)
+		{
+		}
+
+		mapped_shared_ptr(const mapped_shared_ptr& _other) noexcept
+			: _myRefC(_other._myRefC)
+		{
+			if (_myRefC)
+				_myRefC->_Increment();
+		}
+
+		mapped_shared_ptr(mapped_shared_ptr&& _other) noexcept
+			: _myRefC(_other._myRefC)
+		{
+			_other._myRefC = nullptr;
+		}
+
+		~mapped_shared_ptr() {
+			if (_myRefC)
+				_myRefC->_Decrement();
+		}
+
+		mapped_shared_ptr& operator=(const mapped_shared_ptr& _other) noexcept {
+			mapped_shared_ptr(_other).swap(*this);
+			return *this;
+		}
+
+		mapped_shared_ptr& operator=(mapped_shared_ptr&& _other) noexcept {
+			mapped_shared_ptr(::std::move(_other)).swap(*this);
+			return *this;
+		}
+
+		void swap(mapped_shared_ptr& _other) noexcept {
+			Mapped_Ref_Count<_T>* _tmp = _myRefC.get();
+			_myRefC = _other._myRefC;
+			_other._myRefC = _tmp;
+		}
+
+		void reset() noexcept {
+			mapped_shared_ptr().swap(*this);
+		}
+
+		_T* get() const noexcept {
+			return _myRefC ? _myRefC->_Getptr() : nullptr;
+		}
+
+		_T& operator*() const noexcept {
+			return *get();
+		}
+
+		_T* operator->() const noexcept {
+			return get();
+		}
+
+		long use_count() const noexcept {
+			if (!_myRefC)
+				return 0;
+			return _myRefC->_Get_Use_Count();
+		}
+
+		explicit operator bool() const noexcept {
+			return (get() != nullptr);
+		}
+
+	private:
+		offset_ptr<Mapped_Ref_Count<_T>> _myRefC;
+	};
+
+	// constructs a _T inside the segment. other processes see its bytes at a
+	// different address, so _T must hold no absolute pointers (raw pointers,
+	// references, std::string, std::vector, ...) and no vtable; links to other
+	// mapped objects go through offset_ptr or mapped_shared_ptr
+	template <typename _T, typename... _Args>
+	mapped_shared_ptr<_T> make_mapped_shared(mapped_segment& _seg, _Args&&... _args) {
+		static_assert(!is_polymorphic<_T>::value,
+			"a vptr is only valid in the process that constructed the object");
+
+		typedef Mapped_Ref_Count<_T> _MyRefType;
+		void* _mem = _seg.allocate(sizeof(_MyRefType));
+		mapped_shared_ptr<_T> _ret;
+		try {
+			_ret._myRefC = new (_mem) _MyRefType(_seg._Header(), ::std::forward<_Args>(_args)...);
+		}
+		catch (...) {
+			_seg.deallocate(_mem);
+			throw;
+		}
+		return _ret;
+	}
+//*********************************************************************************************************
+}
+
+#endif
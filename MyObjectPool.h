@@ -0,0 +1,349 @@
+#ifndef _MYOBJECTPOOL_H_
+#define _MYOBJECTPOOL_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "MySmartPtr.h"
+
+namespace MyTR1 {
+
+	template <typename _T>
+	class object_pool;
+
+	template <typename _T>
+	struct _Pool_Node;
+
+	// control block of a pooled object. it is constructed in room reserved in
+	// the pool node, and releasing it hands the node back to the pool instead
+	// of destroying the object
+	template <typename _T>
+	class Ref_Count_Pooled : public _Ref_Count_Base<_T>::type {
+	public:
+		explicit Ref_Count_Pooled(_Pool_Node<_T>* _node)
+			: _Ref_Count_Base<_T>::type(), _myNode(_node)
+		{
+		}
+
+		virtual void _Destroy() noexcept
+		{
+		}
+
+		virtual void _Delete() noexcept {
+			_Pool_Node<_T>* _node = _myNode;
+			this->~Ref_Count_Pooled();
+			_node->_myPool->_Release(_node);
+		}
+
+	private:
+		_Pool_Node<_T>* _myNode;
+	};
+
+	template <typename _T>
+	struct _Pool_Node {
+		explicit _Pool_Node(object_pool<_T>* _pool)
+			: _myPool(_pool), _next(nullptr), _myObj()
+		{
+		}
+
+		object_pool<_T>* _myPool;
+		_Pool_Node* _next;
+		alignas(Ref_Count_Pooled<_T>) unsigned char _myRefStorage[sizeof(Ref_Count_Pooled<_T>)];
+		_T _myObj;
+	};
+
+	// deleter of the unique_ptr returned by make_pooled_unique
+	template <typename _T>
+	class pooled_delete {
+	public:
+		constexpr pooled_delete() noexcept
+			: _myNode(nullptr)
+		{
+		}
+
+		explicit pooled_delete(_Pool_Node<_T>* _node) noexcept
+			: _myNode(_node)
+		{
+		}
+
+		void operator()(_T* _ptr) {
+			if (_ptr && _myNode) {
+				_myNode->_myPool->_Release(_myNode);
+				_myNode = nullptr;
+			}
+		}
+
+	private:
+		_Pool_Node<_T>* _myNode;
+	};
+
+	inline unsigned _Pool_Thread_Slot() noexcept {
+		static ::std::atomic<unsigned> _next(0);
+		static thread_local unsigned _slot = _next.fetch_add(1, ::std::memory_order_relaxed);
+		return _slot;
+	}
+
+	// recycles default-constructed _T objects, each stored next to room for its
+	// control block, so make_pooled_shared and make_pooled_unique allocate
+	// nothing on a hit. released objects go through the optional reset hook,
+	// then into a small cache picked by the releasing thread; caches spill
+	// into and refill from a shared depot in batches. the pool must outlive
+	// every object taken from it
+	template <typename _T>
+	class object_pool {
+		template <typename _Tx>
+		friend class Ref_Count_Pooled;
+
+		template <typename _Tx>
+		friend class pooled_delete;
+
+		template <typename _Tx>
+		friend shared_ptr<_Tx> make_pooled_shared(object_pool<_Tx>& _pool);
+
+		template <typename _Tx>
+		friend unique_ptr<_Tx, pooled_delete<_Tx>> make_pooled_unique(object_pool<_Tx>& _pool);
+
+		//a reused object would keep its _weak_this, and with it the old control block
+		static_assert(!is_base_of<enable_shared_from_this<_T>, _T>::value,
+			"enable_shared_from_this types cannot be pooled");
+
+	public:
+		typedef _T value_type;
+		typedef ::std::function<void(_T&)> reset_type;
+
+		explicit object_pool(size_t _maxCached = 4096, reset_type _reset = reset_type(),
+		                     size_t _threadCached = 64)
+			: _myReset(::std::move(_reset)), _myMaxCached(_maxCached),
+			  _myThreadCached(_threadCached ? _threadCached : 1),
+			  _myDepot(nullptr), _myDepotSize(0),
+			  _myHits(0), _myMisses(0), _myIdleMark(0)
+		{
+		}
+
+		object_pool(const object_pool&) = delete;
+
+		object_pool& operator=(const object_pool&) = delete;
+
+		~object_pool() {
+			trim();
+		}
+
+		// frees every cached object
+		void trim() noexcept {
+			for (size_t _i = 0; _i < _Shards; ++_i) {
+				_Shard& _shard = _myShards[_i];
+				_shard._Lock();
+				_Pool_Node<_T>* _list = _shard._head;
+				_shard._head = nullptr;
+				_shard._count = 0;
+				_shard._Unlock();
+				_Free_List(_list);
+			}
+			_Pool_Node<_T>* _list;
+			{
+				::std::lock_guard<::std::mutex> _guard(_myDepotLock);
+				_list = _myDepot;
+				_myDepot = nullptr;
+				_myDepotSize = 0;
+			}
+			_Free_List(_list);
+		}
+
+		// trims if nothing was taken from the pool since the previous call,
+		// meant to be called periodically
+		bool trim_if_idle() noexcept {
+			unsigned long _mark = hits() + misses();
+			if (_mark != _myIdleMark.exchange(_mark, ::std::memory_order_relaxed))
+				return false;
+			trim();
+			return true;
+		}
+
+		unsigned long hits() const noexcept {
+			return _myHits.load(::std::memory_order_relaxed);
+		}
+
+		unsigned long misses() const noexcept {
+			return _myMisses.load(::std::memory_order_relaxed);
+		}
+
+	private:
+		static const size_t _Shards = 16;
+
+		struct alignas(_Cache_Line_Size) _Shard {
+			_Shard()
+				: _head(nullptr), _count(0)
+			{
+				_lock.clear();
+			}
+
+			//critical sections are a few pointer updates, but more threads than
+			//shards share one, so give up the core after a short spin
+			void _Lock() noexcept {
+				for (unsigned _spins = 0; _lock.test_and_set(::std::memory_order_acquire); ++_spins)
+					if (_spins >= 64)
+						::std::this_thread::yield();
+			}
+
+			void _Unlock() noexcept {
+				_lock.clear(::std::memory_order_release);
+			}
+
+			::std::atomic_flag _lock;
+			_Pool_Node<_T>* _head;
+			size_t _count;
+		};
+
+		static void _Free_List(_Pool_Node<_T>* _list) noexcept {
+			while (_list) {
+				_Pool_Node<_T>* _next = _list->_next;
+				delete _list;
+				_list = _next;
+			}
+		}
+
+		_Shard& _My_Shard() noexcept {
+			return _myShards[_Pool_Thread_Slot() % _Shards];
+		}
+
+		_Pool_Node<_T>* _Acquire() {
+			_Shard& _shard = _My_Shard();
+			_shard._Lock();
+			_Pool_Node<_T>* _node = _shard._head;
+			if (_node) {
+				_shard._head = _node->_next;
+				--_shard._count;
+			}
+			_shard._Unlock();
+
+			//the depot is refilled from with the shard unlocked, so threads
+			//sharing the shard never spin while this one waits on the mutex
+			if (!_node) {
+				size_t _count;
+				_node = _Take_From_Depot(_count);
+				if (_node && _node->_next)
+					_Give_To_Shard(_shard, _node->_next, _count - 1);
+			}
+
+			if (_node) {
+				_myHits.fetch_add(1, ::std::memory_order_relaxed);
+				return _node;
+			}
+			_myMisses.fetch_add(1, ::std::memory_order_relaxed);
+			return new _Pool_Node<_T>(this);
+		}
+
+		void _Release(_Pool_Node<_T>* _node) noexcept {
+			if (_myReset)
+				_myReset(_node->_myObj);
+
+			_Shard& _shard = _My_Shard();
+			_shard._Lock();
+			_node->_next = _shard._head;
+			_shard._head = _node;
+			_Pool_Node<_T>* _spill = nullptr;
+			if (++_shard._count > _myThreadCached)
+				_spill = _Take_Half(_shard);
+			_shard._Unlock();
+
+			if (_spill)
+				_Spill(_spill);
+		}
+
+		//detaches a batch of up to half a cache plus one from the depot
+		_Pool_Node<_T>* _Take_From_Depot(size_t& _count) noexcept {
+			::std::lock_guard<::std::mutex> _guard(_myDepotLock);
+			size_t _want = _myThreadCached / 2 + 1;
+			_Pool_Node<_T>* _list = nullptr;
+			for (_count = 0; _myDepot && _count < _want; ++_count) {
+				_Pool_Node<_T>* _node = _myDepot;
+				_myDepot = _node->_next;
+				--_myDepotSize;
+				_node->_next = _list;
+				_list = _node;
+			}
+			return _list;
+		}
+
+		//caches the rest of a depot batch, spilling again if other threads
+		//filled the shard meanwhile
+		void _Give_To_Shard(_Shard& _shard, _Pool_Node<_T>* _list, size_t _count) noexcept {
+			_Pool_Node<_T>* _last = _list;
+			while (_last->_next)
+				_last = _last->_next;
+
+			_shard._Lock();
+			_last->_next = _shard._head;
+			_shard._head = _list;
+			_shard._count += _count;
+			_Pool_Node<_T>* _spill = nullptr;
+			if (_shard._count > _myThreadCached)
+				_spill = _Take_Half(_shard);
+			_shard._Unlock();
+
+			if (_spill)
+				_Spill(_spill);
+		}
+
+		_Pool_Node<_T>* _Take_Half(_Shard& _shard) noexcept {
+			size_t _keep = _myThreadCached / 2;
+			_Pool_Node<_T>* _last = _shard._head;
+			for (size_t _i = 1; _i < _keep; ++_i)
+				_last = _last->_next;
+			_Pool_Node<_T>* _spill = _keep ? _last->_next : _shard._head;
+			if (_keep)
+				_last->_next = nullptr;
+			else
+				_shard._head = nullptr;
+			_shard._count = _keep;
+			return _spill;
+		}
+
+		void _Spill(_Pool_Node<_T>* _list) noexcept {
+			_Pool_Node<_T>* _excess = nullptr;
+			{
+				::std::lock_guard<::std::mutex> _guard(_myDepotLock);
+				while (_list && _myDepotSize < _myMaxCached) {
+					_Pool_Node<_T>* _next = _list->_next;
+					_list->_next = _myDepot;
+					_myDepot = _list;
+					++_myDepotSize;
+					_list = _next;
+				}
+				_excess = _list;
+			}
+			_Free_List(_excess);
+		}
+
+		reset_type _myReset;
+		size_t _myMaxCached;
+		size_t _myThreadCached;
+		_Shard _myShards[_Shards];
+		::std::mutex _myDepotLock;
+		_Pool_Node<_T>* _myDepot;
+		size_t _myDepotSize;
+		::std::atomic<unsigned long> _myHits;
+		::std::atomic<unsigned long> _myMisses;
+		::std::atomic<unsigned long> _myIdleMark;
+	};
+
+	template <typename _T>
+	shared_ptr<_T> make_pooled_shared(object_pool<_T>& _pool) {
+		_Pool_Node<_T>* _node = _pool._Acquire();
+		Ref_Count_Pooled<_T>* _refPtr = ::new (static_cast<void*>(_node->_myRefStorage)) Ref_Count_Pooled<_T>(_node);
+		return shared_ptr<_T>::_Adopt(&_node->_myObj, _refPtr);
+	}
+
+	template <typename _T>
+	unique_ptr<_T, pooled_delete<_T>> make_pooled_unique(object_pool<_T>& _pool) {
+		_Pool_Node<_T>* _node = _pool._Acquire();
+		return unique_ptr<_T, pooled_delete<_T>>(&_node->_myObj, pooled_delete<_T>(_node));
+	}
+}
+
+#endif
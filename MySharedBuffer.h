@@ -0,0 +1,257 @@
+#ifndef _MYSHAREDBUFFER_H_
+#define _MYSHAREDBUFFER_H_
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "MySmartPtr.h"
+
+namespace MyTR1 {
+
+	// a control block immediately followed by the bytes it owns, so a buffer
+	// takes a single allocation
+	class alignas(alignof(::std::max_align_t)) Ref_Count_Buffer : public Ref_Count {
+	public:
+		static Ref_Count_Buffer* _Create(size_t _size) {
+			void* _mem = ::operator new(sizeof(Ref_Count_Buffer) + _size);
+			return ::new (_mem) Ref_Count_Buffer();
+		}
+
+		unsigned char* _Data() noexcept {
+			return reinterpret_cast<unsigned char*>(this + 1);
+		}
+
+		virtual void _Destroy() noexcept
+		{
+		}
+
+		virtual void _Delete() noexcept {
+			this->~Ref_Count_Buffer();
+			::operator delete(static_cast<void*>(this));
+		}
+
+	private:
+		Ref_Count_Buffer()
+			: Ref_Count()
+		{
+		}
+	};
+
+	struct _Munmap_Delete {
+		size_t _myLength;
+
+		void operator()(unsigned char* _ptr) const noexcept {
+			::munmap(_ptr, _myLength);
+		}
+	};
+
+	// a reference-counted byte range. slice() returns views that share the
+	// same control block through the aliasing constructor, so handing a part
+	// of a buffer to the next stage costs one increment and no copy
+	class shared_buffer {
+	public:
+		shared_buffer() noexcept
+			: _myData(), _mySize(0)
+		{
+		}
+
+		explicit shared_buffer(size_t _size)
+			: _myData(), _mySize(_size)
+		{
+			if (_size) {
+				Ref_Count_Buffer* _refPtr = Ref_Count_Buffer::_Create(_size);
+				_myData = shared_ptr<unsigned char>::_Adopt(_refPtr->_Data(), _refPtr);
+			}
+		}
+
+		// shares ownership of _len bytes at _data with _owner
+		template <typename _U>
+		shared_buffer(const shared_ptr<_U>& _owner, unsigned char* _data, size_t _len)
+			: _myData(_owner, _data), _mySize(_len)
+		{
+		}
+
+		// takes ownership of a whole mapping returned by mmap
+		static shared_buffer adopt_mapping(void* _addr, size_t _len) {
+			unsigned char* _ptr = static_cast<unsigned char*>(_addr);
+			_Munmap_Delete _del = { _len };
+			shared_buffer _ret;
+			try {
+				_ret._myData = shared_ptr<unsigned char>(_ptr, _del);
+			}
+			catch (...) {
+				_del(_ptr);
+				throw;
+			}
+			_ret._mySize = _len;
+			return _ret;
+		}
+
+		// maps a whole file copy-on-write. the buffer is writable like any
+		// other, but writes stay private to this process and never reach the file
+		static shared_buffer map_file(const char* _path) {
+			int _fd = ::open(_path, O_RDONLY);
+			if (_fd < 0)
+				throw ::std::system_error(errno, ::std::system_category(), "open");
+			struct stat _st;
+			if (::fstat(_fd, &_st) != 0) {
+				int _err = errno;
+				::close(_fd);
+				throw ::std::system_error(_err, ::std::system_category(), "fstat");
+			}
+			size_t _len = static_cast<size_t>(_st.st_size);
+			if (_len == 0) {
+				::close(_fd);
+				return shared_buffer();
+			}
+			void* _addr = ::mmap(nullptr, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+			int _err = errno;
+			::close(_fd);
+			if (_addr == MAP_FAILED)
+				throw ::std::system_error(_err, ::std::system_category(), "mmap");
+			return adopt_mapping(_addr, _len);
+		}
+
+		unsigned char* data() const noexcept {
+			return _myData.get();
+		}
+
+		size_t size() const noexcept {
+			return _mySize;
+		}
+
+		bool empty() const noexcept {
+			return _mySize == 0;
+		}
+
+		unsigned char& operator[](size_t _index) const noexcept {
+			assert(_index < _mySize);
+			return data()[_index];
+		}
+
+		shared_buffer slice(size_t _offset, size_t _len) const {
+			assert(_offset <= _mySize && _len <= _mySize - _offset);
+			return shared_buffer(_myData, data() + _offset, _len);
+		}
+
+		shared_buffer slice(size_t _offset) const {
+			assert(_offset <= _mySize);
+			return slice(_offset, _mySize - _offset);
+		}
+
+		long use_count() const noexcept {
+			return _myData.use_count();
+		}
+
+		::iovec as_iovec() const noexcept {
+			::iovec _iov;
+			_iov.iov_base = data();
+			_iov.iov_len = _mySize;
+			return _iov;
+		}
+
+		void swap(shared_buffer& _other) noexcept {
+			_myData.swap(_other._myData);
+			::std::swap(_mySize, _other._mySize);
+		}
+
+		void reset() noexcept {
+			shared_buffer().swap(*this);
+		}
+
+	private:
+		shared_ptr<unsigned char> _myData;
+		size_t _mySize;
+	};
+
+	// an ordered list of buffers kept alongside its iovec array, ready to be
+	// passed to writev or readv without gathering the bytes first
+	class buffer_chain {
+	public:
+		typedef ::std::vector<shared_buffer>::const_iterator const_iterator;
+
+		buffer_chain() noexcept
+			: _myBytes(0)
+		{
+		}
+
+		void push_back(shared_buffer _buf) {
+			_myIov.push_back(_buf.as_iovec());
+			try {
+				_myBytes += _buf.size();
+				_myBufs.push_back(::std::move(_buf));
+			}
+			catch (...) {
+				_myBytes -= _myIov.back().iov_len;
+				_myIov.pop_back();
+				throw;
+			}
+		}
+
+		// drops the first _bytes, e.g. what a partial writev already sent
+		void consume(size_t _bytes) {
+			assert(_bytes <= _myBytes);
+			_myBytes -= _bytes;
+			size_t _drop = 0;
+			while (_drop < _myBufs.size() && _bytes >= _myBufs[_drop].size()) {
+				_bytes -= _myBufs[_drop].size();
+				++_drop;
+			}
+			_myBufs.erase(_myBufs.begin(), _myBufs.begin() + _drop);
+			_myIov.erase(_myIov.begin(), _myIov.begin() + _drop);
+			if (_bytes) {
+				_myBufs.front() = _myBufs.front().slice(_bytes);
+				_myIov.front() = _myBufs.front().as_iovec();
+			}
+		}
+
+		void clear() noexcept {
+			_myBufs.clear();
+			_myIov.clear();
+			_myBytes = 0;
+		}
+
+		const ::iovec* iov() const noexcept {
+			return _myIov.data();
+		}
+
+		int iovcnt() const noexcept {
+			return static_cast<int>(_myIov.size());
+		}
+
+		// total number of bytes in the chain
+		size_t size() const noexcept {
+			return _myBytes;
+		}
+
+		bool empty() const noexcept {
+			return _myBufs.empty();
+		}
+
+		const_iterator begin() const noexcept {
+			return _myBufs.begin();
+		}
+
+		const_iterator end() const noexcept {
+			return _myBufs.end();
+		}
+
+	private:
+		::std::vector<shared_buffer> _myBufs;
+		::std::vector<::iovec> _myIov;
+		size_t _myBytes;
+	};
+}
+
+#endif
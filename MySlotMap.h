@@ -0,0 +1,266 @@
+#ifndef _MYSLOTMAP_H_
+#define _MYSLOTMAP_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace MyTR1 {
+
+	template <typename _T, bool _Concurrent>
+	class slot_map;
+
+	// an index plus the generation of the slot at the time the element was
+	// inserted. it owns nothing: a handle whose element has been erased simply
+	// stops resolving, which is all a weak_ptr used as "is it still alive" gives
+	template <typename _T>
+	class handle {
+		template <typename _Tx, bool _Cx>
+		friend class slot_map;
+
+	public:
+		constexpr handle() noexcept
+			: _myIndex(_Invalid), _myGen(0)
+		{
+		}
+
+		::std::uint32_t index() const noexcept {
+			return _myIndex;
+		}
+
+		::std::uint32_t generation() const noexcept {
+			return _myGen;
+		}
+
+		explicit operator bool() const noexcept {
+			return (_myIndex != _Invalid);
+		}
+
+		bool operator==(const handle& _other) const noexcept {
+			return _myIndex == _other._myIndex && _myGen == _other._myGen;
+		}
+
+		bool operator!=(const handle& _other) const noexcept {
+			return !(*this == _other);
+		}
+
+	private:
+		static constexpr ::std::uint32_t _Invalid = ~::std::uint32_t(0);
+
+		constexpr handle(::std::uint32_t _index, ::std::uint32_t _gen) noexcept
+			: _myIndex(_index), _myGen(_gen)
+		{
+		}
+
+		::std::uint32_t _myIndex;
+		::std::uint32_t _myGen;
+	};
+
+	template <bool _Concurrent>
+	struct _Slot_Generation {
+		_Slot_Generation() noexcept
+			: _value(0)
+		{
+		}
+
+		::std::uint32_t _Load() const noexcept {
+			return _value;
+		}
+
+		void _Bump() noexcept {
+			++_value;
+		}
+
+		::std::uint32_t _value;
+	};
+
+	template <>
+	struct _Slot_Generation<true> {
+		_Slot_Generation() noexcept
+			: _value(0)
+		{
+		}
+
+		//only needed while the slot array grows, which is never concurrent
+		_Slot_Generation(const _Slot_Generation& _other) noexcept
+			: _value(_other._value.load(::std::memory_order_relaxed))
+		{
+		}
+
+		::std::uint32_t _Load() const noexcept {
+			return _value.load(::std::memory_order_acquire);
+		}
+
+		void _Bump() noexcept {
+			_value.fetch_add(1, ::std::memory_order_release);
+		}
+
+		::std::atomic<::std::uint32_t> _value;
+	};
+
+	// elements live contiguously in insertion order modulo erasures (erase moves
+	// the last element into the hole), so iteration walks a plain array.
+	// lookups through a handle are a bounds check and a generation compare.
+	//
+	// with _Concurrent set, slot generations are atomic, which buys exactly one
+	// guarantee: other threads may call contains() while this one calls erase().
+	// nothing else may overlap with anything: emplace() and insert() change the
+	// slot array contains() bounds-checks against, and get() and operator[]
+	// read elements erase() moves, so all of those need outside locking.
+	template <typename _T, bool _Concurrent = false>
+	class slot_map {
+	public:
+		typedef _T value_type;
+		typedef MyTR1::handle<_T> handle_type;
+		typedef typename ::std::vector<_T>::iterator iterator;
+		typedef typename ::std::vector<_T>::const_iterator const_iterator;
+
+		slot_map()
+			: _myFreeHead(_Invalid)
+		{
+		}
+
+		void reserve(size_t _count) {
+			_myValues.reserve(_count);
+			_myOwners.reserve(_count);
+			_mySlots.reserve(_count);
+		}
+
+		template <typename... _Args>
+		handle_type emplace(_Args&&... _args) {
+			_myValues.emplace_back(::std::forward<_Args>(_args)...);
+			::std::uint32_t _slot;
+			try {
+				if (_myFreeHead != _Invalid) {
+					_slot = _myFreeHead;
+					_myOwners.push_back(_slot);
+					_myFreeHead = _mySlots[_slot]._index;
+				}
+				else {
+					_slot = static_cast<::std::uint32_t>(_mySlots.size());
+					_myOwners.push_back(_slot);
+					_mySlots.emplace_back();
+				}
+			}
+			catch (...) {
+				if (_myOwners.size() == _myValues.size())
+					_myOwners.pop_back();
+				_myValues.pop_back();
+				throw;
+			}
+			_mySlots[_slot]._index = static_cast<::std::uint32_t>(_myValues.size() - 1);
+			return handle_type(_slot, _mySlots[_slot]._gen._Load());
+		}
+
+		handle_type insert(const _T& _value) {
+			return emplace(_value);
+		}
+
+		handle_type insert(_T&& _value) {
+			return emplace(::std::move(_value));
+		}
+
+		bool erase(handle_type _h) {
+			if (!contains(_h))
+				return false;
+
+			_Slot& _slot = _mySlots[_h._myIndex];
+			::std::uint32_t _dense = _slot._index;
+			::std::uint32_t _last = static_cast<::std::uint32_t>(_myValues.size() - 1);
+			if (_dense != _last) {
+				_myValues[_dense] = ::std::move(_myValues[_last]);
+				_myOwners[_dense] = _myOwners[_last];
+				_mySlots[_myOwners[_dense]]._index = _dense;
+			}
+			_myValues.pop_back();
+			_myOwners.pop_back();
+
+			_slot._gen._Bump();
+			_slot._index = _myFreeHead;
+			_myFreeHead = _h._myIndex;
+			return true;
+		}
+
+		bool contains(handle_type _h) const noexcept {
+			return _h._myIndex < _mySlots.size()
+				&& _mySlots[_h._myIndex]._gen._Load() == _h._myGen;
+		}
+
+		_T* get(handle_type _h) noexcept {
+			return contains(_h) ? &_myValues[_mySlots[_h._myIndex]._index] : nullptr;
+		}
+
+		const _T* get(handle_type _h) const noexcept {
+			return contains(_h) ? &_myValues[_mySlots[_h._myIndex]._index] : nullptr;
+		}
+
+		_T& operator[](handle_type _h) noexcept {
+			assert(contains(_h));
+			return _myValues[_mySlots[_h._myIndex]._index];
+		}
+
+		const _T& operator[](handle_type _h) const noexcept {
+			assert(contains(_h));
+			return _myValues[_mySlots[_h._myIndex]._index];
+		}
+
+		void clear() {
+			while (!_myValues.empty()) {
+				::std::uint32_t _slot = _myOwners.back();
+				erase(handle_type(_slot, _mySlots[_slot]._gen._Load()));
+			}
+		}
+
+		size_t size() const noexcept {
+			return _myValues.size();
+		}
+
+		bool empty() const noexcept {
+			return _myValues.empty();
+		}
+
+		iterator begin() noexcept {
+			return _myValues.begin();
+		}
+
+		iterator end() noexcept {
+			return _myValues.end();
+		}
+
+		const_iterator begin() const noexcept {
+			return _myValues.begin();
+		}
+
+		const_iterator end() const noexcept {
+			return _myValues.end();
+		}
+
+		_T* data() noexcept {
+			return _myValues.data();
+		}
+
+		const _T* data() const noexcept {
+			return _myValues.data();
+		}
+
+	private:
+		static constexpr ::std::uint32_t _Invalid = ~::std::uint32_t(0);
+
+		struct _Slot {
+			//dense index while the slot is live, next free slot otherwise
+			::std::uint32_t _index;
+			_Slot_Generation<_Concurrent> _gen;
+		};
+
+		::std::vector<_T> _myValues;
+		//slot owning each dense element, to fix up the slot when an element moves
+		::std::vector<::std::uint32_t> _myOwners;
+		::std::vector<_Slot> _mySlots;
+		::std::uint32_t _myFreeHead;
+	};
+}
+
+#endif
@@ -3,7 +3,10 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <new>
 #include <utility>
+#include <vector>
 
 namespace MyTR1 {
 
@@ -116,6 +119,34 @@ namespace MyTR1 {
 		static constexpr bool value = sizeof(helper(_convert(), 0)) == sizeof(char);
 	};
 
+	// these need the compiler's help, as MSVC, GCC and Clang all provide
+	template <typename _T>
+	struct is_polymorphic : integral_constant<bool, __is_polymorphic(_T)>
+	{
+	};
+
+	template <typename _T>
+	struct is_trivially_destructible : integral_constant<bool, __has_trivial_destructor(_T)>
+	{
+	};
+
+	template <typename _T>
+	struct is_trivially_default_constructible : integral_constant<bool, __is_trivially_constructible(_T)>
+	{
+	};
+
+	// false rather than an error for types that cannot be moved at all
+	template <typename _T>
+	struct is_nothrow_move_constructible {
+		template <typename _U>
+		static integral_constant<bool, noexcept(_U(::std::declval<_U>()))> helper(int);
+
+		template <typename _U>
+		static false_type helper(...);
+
+		static constexpr bool value = decltype(helper<_T>(0))::value;
+	};
+
 	template <typename _T>
 	struct is_function {
 		static const bool value = !is_convertible<_T*, const volatile void*>::value;
@@ -172,6 +203,41 @@ namespace MyTR1 {
 		typedef _T type;
 	};
 
+	template <typename _T>
+	struct remove_extent {
+		typedef _T type;
+	};
+
+	template <typename _T>
+	struct remove_extent<_T[]> {
+		typedef _T type;
+	};
+
+	template <typename _T, size_t _N>
+	struct remove_extent<_T[_N]> {
+		typedef _T type;
+	};
+
+	template <typename _T>
+	struct remove_cv {
+		typedef _T type;
+	};
+
+	template <typename _T>
+	struct remove_cv<const _T> {
+		typedef _T type;
+	};
+
+	template <typename _T>
+	struct remove_cv<volatile _T> {
+		typedef _T type;
+	};
+
+	template <typename _T>
+	struct remove_cv<const volatile _T> {
+		typedef _T type;
+	};
+
 	template <typename _T>
 	struct add_lvalue_reference {
 		typedef _T& type;
@@ -253,6 +319,12 @@ namespace MyTR1 {
 	template <typename _T, typename _D>
 	class unique_ptr;
 
+	template <typename _T>
+	class compact_shared_ptr;
+
+	template <typename _T>
+	class borrowed_ptr;
+
 	template <typename _T>
 	class enable_shared_from_this {
 		friend class shared_ptr<_T>;
@@ -291,23 +363,79 @@ namespace MyTR1 {
 		weak_ptr<_T> _weak_this;
 	};
 
-	class Ref_Count {
+	// the strong count and the borrow check, shared by Ref_Count and
+	// Ref_Count_Strong. they differ only in what follows _Destroy() once the
+	// last owner is gone
+	class _Ref_Count_Common {
 	public:
-		Ref_Count()
-			: _use(1), _weak_use(0)
+		void _Increment() {
+			++_use;
+		}
+
+		unsigned long _Get_Use_Count() {
+			return _use.load();
+		}
+
+#ifdef _MYTR1_DEBUG_BORROW
+		void _Increment_Borrow() {
+			++_borrow;
+		}
+
+		void _Decrement_Borrow() {
+			--_borrow;
+		}
+#endif
+
+		virtual ~_Ref_Count_Common() noexcept
 		{
 		}
 
-		void _Increment() {
-			++_use;
+		// destroy the object pointed by the pointer 
+		virtual void _Destroy() noexcept = 0;
+
+		// destroy the reference count object
+		virtual void _Delete() noexcept = 0;
+
+	protected:
+		_Ref_Count_Common()
+			: _use(1)
+#ifdef _MYTR1_DEBUG_BORROW
+			, _borrow(0)
+#endif
+		{
+		}
+
+		//drops one owner, true if it was the last
+		bool _Release() {
+			if (--_use != 0)
+				return false;
+#ifdef _MYTR1_DEBUG_BORROW
+			assert(_borrow == 0 && "borrowed_ptr outlived the object it borrows");
+#endif
+			return true;
+		}
+
+	private:
+		::std::atomic<unsigned long> _use;
+#ifdef _MYTR1_DEBUG_BORROW
+		::std::atomic<unsigned long> _borrow;
+#endif
+	};
+
+	class Ref_Count : public _Ref_Count_Common {
+	public:
+		//the owners together hold one weak reference, dropped only after
+		//_Destroy(), so the block survives whatever _Destroy() does to weak
+		//pointers to it (e.g. the _weak_this of enable_shared_from_this)
+		Ref_Count()
+			: _Ref_Count_Common(), _weak_use(1)
+		{
 		}
 
 		void _Decrement() {
-			--_use;
-			if (_use == 0) {
+			if (_Release()) {
 				_Destroy();
-				if (_weak_use == 0)
-					_Delete();
+				_Decrement_Weak();
 			}
 		}
 
@@ -316,41 +444,137 @@ namespace MyTR1 {
 		}
 
 		void _Decrement_Weak() {
-			--_weak_use;
-			if (_use == 0 && _weak_use == 0) {
+			if (--_weak_use == 0) {
 				_Delete();
 			}
 		}
 
-		unsigned long _Get_Use_Count() {
-			return _use.load();
-		}
+	private:
+		::std::atomic<unsigned long> _weak_use;
+	};
+
+	// most types are never observed through weak_ptr. specializing no_weak_ref
+	// for such a type gives its control blocks no weak count: they shrink to a
+	// single counter and releasing the last owner is one atomic operation.
+	// weak_ptr and enable_shared_from_this of the type then fail to compile
+	template <typename _T>
+	struct no_weak_ref : false_type
+	{
+	};
 
-		virtual ~Ref_Count() noexcept
+	class Ref_Count_Strong : public _Ref_Count_Common {
+	public:
+		Ref_Count_Strong()
+			: _Ref_Count_Common()
 		{
 		}
 
-		// destroy the object pointed by the pointer 
-		virtual void _Destroy() noexcept = 0;
+		void _Decrement() {
+			if (_Release()) {
+				_Destroy();
+				_Delete();
+			}
+		}
+	};
 
-		// destroy the reference count object
-		virtual void _Delete() noexcept = 0;
+	// the control block base a shared_ptr<_T> points to
+	template <typename _T>
+	struct _Ref_Count_Base {
+		typedef typename conditional<no_weak_ref<typename remove_cv<_T>::type>::value,
+		                             Ref_Count_Strong, Ref_Count>::type type;
+	};
+
+	// destroying the head of a long chain of owning pointers recurses once per
+	// node and can overflow the stack. destructions started through _Teardown
+	// while another one is running on the same thread are queued instead, and
+	// the outermost one runs them in a loop, so the depth stays constant
+	class _Teardown {
+	public:
+		typedef void (*_Fn)(void*);
+
+		// runs _fn(_obj) now, or queues it if a teardown is already running here
+		static void _Run(void* _obj, _Fn _fn) noexcept {
+			_Worklist*& _pending = _Pending();
+			if (_pending) {
+				try {
+					_pending->push_back(::std::make_pair(_obj, _fn));
+					return;
+				}
+				catch (...) {
+					//out of memory, fall back to recursing
+					_fn(_obj);
+					return;
+				}
+			}
+
+			//the outermost call owns the worklist
+			_Worklist _local;
+			_pending = &_local;
+			_fn(_obj);
+			while (!_local.empty()) {
+				::std::pair<void*, _Fn> _next = _local.back();
+				_local.pop_back();
+				_next.second(_next.first);
+			}
+			_pending = nullptr;
+		}
 
 	private:
-		::std::atomic<unsigned long> _use;
-		::std::atomic<unsigned long> _weak_use;
+		typedef ::std::vector<::std::pair<void*, _Fn>> _Worklist;
+
+		//only a raw pointer is thread_local: it has no destructor, so chains
+		//held by statics can still be torn down at exit, after thread_local
+		//objects are gone
+		static _Worklist*& _Pending() noexcept {
+			static thread_local _Worklist* _pending = nullptr;
+			return _pending;
+		}
+	};
+
+	// deleter that destroys through _Teardown, for unique_ptr chains or as a
+	// shared_ptr deleter
+	template <typename _T>
+	class deferred_delete {
+	public:
+		constexpr deferred_delete() noexcept = default;
+
+		template <typename _U>
+		deferred_delete(const deferred_delete<_U>& _del) noexcept
+		{
+		}
+
+		void operator()(_T* _ptr) const noexcept {
+			if (_ptr)
+				_Teardown::_Run(_ptr, &_Delete_One);
+		}
+
+	private:
+		static void _Delete_One(void* _ptr) noexcept {
+			delete static_cast<_T*>(_ptr);
+		}
 	};
 
+	// specialize for node types of long shared_ptr chains: objects given to the
+	// raw pointer constructor or made by make_shared are then destroyed
+	// through _Teardown
 	template <typename _T>
-	class Ref_Count_Default : public Ref_Count {
+	struct iterative_teardown : false_type
+	{
+	};
+
+	template <typename _T, typename _Base = Ref_Count>
+	class Ref_Count_Default : public _Base {
 	public:
 		Ref_Count_Default(_T* _rawPtr)
-			: Ref_Count(), _ptr(_rawPtr)
+			: _Base(), _ptr(_rawPtr)
 		{
 		}
 
 		virtual void _Destroy() noexcept {
-			delete _ptr;
+			if (iterative_teardown<_T>::value)
+				deferred_delete<_T>()(_ptr);
+			else
+				delete _ptr;
 		}
 
 		virtual void _Delete() noexcept {
@@ -361,11 +585,41 @@ namespace MyTR1 {
 		_T* _ptr;
 	};
 
-	template <typename _T, typename _D>
-	class Ref_Count_Del : public Ref_Count {
+	// several default control blocks fit into one cache line, so copying unrelated
+	// pointers from different threads makes their counts false-share.
+	// specialize is_cache_isolated for such types, or pass cache_isolated to the
+	// constructor, to give each of their control blocks a cache line of its own
+	const size_t _Cache_Line_Size = 64;
+
+	template <typename _T>
+	struct is_cache_isolated : false_type
+	{
+	};
+
+	struct cache_isolated_t
+	{
+	};
+
+	constexpr cache_isolated_t cache_isolated{};
+
+	template <typename _T, typename _Base = Ref_Count>
+	class alignas(_Cache_Line_Size) Ref_Count_Isolated : public Ref_Count_Default<_T, _Base> {
+	public:
+		Ref_Count_Isolated(_T* _rawPtr)
+			: Ref_Count_Default<_T, _Base>(_rawPtr)
+		{
+		}
+
+		virtual void _Delete() noexcept {
+			delete this;
+		}
+	};
+
+	template <typename _T, typename _D, typename _Base = Ref_Count>
+	class Ref_Count_Del : public _Base {
 	public:
 		Ref_Count_Del(_T* _rawPtr, _D _deleter)
-			: Ref_Count(), _myPair(_deleter, _rawPtr)
+			: _Base(), _myPair(_deleter, _rawPtr)
 		{
 		}
 
@@ -381,11 +635,11 @@ namespace MyTR1 {
 		::std::pair<_D, _T*> _myPair;
 	};
 
-	template <typename _T, typename _D, typename _Alloc>
-	class Ref_Count_Del_Alloc : public Ref_Count {
+	template <typename _T, typename _D, typename _Alloc, typename _Base = Ref_Count>
+	class Ref_Count_Del_Alloc : public _Base {
 	public:
 		Ref_Count_Del_Alloc(_T* _rawPtr, _D _deleter, _Alloc _alloc)
-			: Ref_Count(), _myPair(::std::pair<_D, _T*>(_deleter, _rawPtr), _alloc)
+			: _Base(), _myPair(::std::pair<_D, _T*>(_deleter, _rawPtr), _alloc)
 		{
 		}
 
@@ -394,7 +648,7 @@ namespace MyTR1 {
 		}
 
 		virtual void _Delete() noexcept {
-			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc> _MyRefType;
+			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc, _Base> _MyRefType;
 			typename _Alloc::rebind<_MyRefType>::other _actual_Alloc(_myPair.second);
 			_actual_Alloc.destroy(this);
 			_actual_Alloc.deallocate(this, 1);
@@ -404,6 +658,131 @@ namespace MyTR1 {
 		::std::pair<::std::pair<_D, _T*>, _Alloc> _myPair;
 	};
 
+	// holds the object inline, so that the object and its control block take
+	// a single allocation and sit next to each other in memory
+	template <typename _T, typename _Base = typename _Ref_Count_Base<_T>::type>
+	class Ref_Count_Obj : public _Base {
+	public:
+		template <typename... _Args>
+		explicit Ref_Count_Obj(_Args&&... _args)
+			: _Base()
+		{
+			::new (static_cast<void*>(_myStorage)) _T(::std::forward<_Args>(_args)...);
+		}
+
+		_T* _Getptr() noexcept {
+			return reinterpret_cast<_T*>(_myStorage);
+		}
+
+		virtual void _Destroy() noexcept {
+			if (iterative_teardown<_T>::value)
+				_Destroy_Iterative(static_cast<_Base*>(this));
+			else
+				_Getptr()->~_T();
+		}
+
+		virtual void _Delete() noexcept {
+			if (iterative_teardown<_T>::value)
+				_Delete_Iterative(static_cast<_Base*>(this));
+			else
+				delete this;
+		}
+
+	private:
+		//the object lives in the block, so a weak reference keeps the block
+		//alive until the queued destructor has run
+		void _Destroy_Iterative(Ref_Count*) noexcept {
+			this->_Increment_Weak();
+			_Teardown::_Run(this, &_Destroy_Pinned);
+		}
+
+		void _Delete_Iterative(Ref_Count*) noexcept {
+			delete this;
+		}
+
+		//without a weak count _Delete() always directly follows _Destroy(),
+		//so both are queued from _Delete()
+		void _Destroy_Iterative(Ref_Count_Strong*) noexcept
+		{
+		}
+
+		void _Delete_Iterative(Ref_Count_Strong*) noexcept {
+			_Teardown::_Run(this, &_Destroy_Free);
+		}
+
+		static void _Destroy_Pinned(void* _self) noexcept {
+			Ref_Count_Obj* _refPtr = static_cast<Ref_Count_Obj*>(_self);
+			_refPtr->_Getptr()->~_T();
+			_refPtr->_Decrement_Weak();
+		}
+
+		static void _Destroy_Free(void* _self) noexcept {
+			Ref_Count_Obj* _refPtr = static_cast<Ref_Count_Obj*>(_self);
+			_refPtr->_Getptr()->~_T();
+			delete _refPtr;
+		}
+
+		alignas(_T) unsigned char _myStorage[sizeof(_T)];
+	};
+
+	// what make_shared creates for a type specialized as is_cache_isolated:
+	// the object and its count share a cache line only with each other
+	template <typename _T, typename _Base = typename _Ref_Count_Base<_T>::type>
+	class alignas(_Cache_Line_Size) Ref_Count_Obj_Isolated : public Ref_Count_Obj<_T, _Base> {
+	public:
+		template <typename... _Args>
+		explicit Ref_Count_Obj_Isolated(_Args&&... _args)
+			: Ref_Count_Obj<_T, _Base>(::std::forward<_Args>(_args)...)
+		{
+		}
+	};
+
+	template <typename _T>
+	struct _Ref_Count_Obj_For {
+		typedef typename conditional<is_cache_isolated<_T>::value,
+		                             Ref_Count_Obj_Isolated<_T>, Ref_Count_Obj<_T>>::type type;
+	};
+
+	// deleter of the unique_ptr returned by make_unique_shareable: the object
+	// already lives in a control block, so promoting it to a shared_ptr later
+	// needs no allocation
+	template <typename _T>
+	class shareable_delete {
+		template <typename _U>
+		friend class shareable_delete;
+
+	public:
+		constexpr shareable_delete() noexcept
+			: _myRefC(nullptr)
+		{
+		}
+
+		explicit shareable_delete(typename _Ref_Count_Base<_T>::type* _refC) noexcept
+			: _myRefC(_refC)
+		{
+		}
+
+		template <typename _U>
+		shareable_delete(const shareable_delete<_U>& _del) noexcept
+			: _myRefC(_del._myRefC)
+		{
+		}
+
+		void operator()(_T* _ptr) {
+			if (_ptr && _myRefC) {
+				_myRefC->_Decrement();
+				_myRefC = nullptr;
+			}
+		}
+
+		typename _Ref_Count_Base<_T>::type* _Get_Ref_Count() const noexcept {
+			return _myRefC;
+		}
+
+	private:
+		typename _Ref_Count_Base<_T>::type* _myRefC;
+	};
+
 	template <typename _T>
 	class shared_ptr {
 		template <typename _Tx>
@@ -415,8 +794,21 @@ namespace MyTR1 {
 		template <typename _Tx, typename _Dx>
 		friend class unique_ptr;
 
+		template <typename _Tx>
+		friend class compact_shared_ptr;
+
+		template <typename _Tx>
+		friend class borrowed_ptr;
+
+		template <typename _Tx, typename... _Args>
+		friend shared_ptr<_Tx> make_shared(_Args&&... _args);
+
+		template <typename _Tx, typename... _Args>
+		friend compact_shared_ptr<_Tx> make_compact_shared(_Args&&... _args);
+
 	public:
 		typedef _T element_type;
+		typedef typename _Ref_Count_Base<_T>::type _Ref_Type;
 
 		constexpr shared_ptr() noexcept
 			// default constructor
@@ -433,7 +825,17 @@ namespace MyTR1 {
 		template <typename _Y>
 		explicit shared_ptr(_Y* _rawPtr)
 			//raw pointer constructor
-			: _myPtr(_rawPtr), _myRefC(new Ref_Count_Default<_Y>(_rawPtr))
+			: _myPtr(_rawPtr), _myRefC(new typename conditional<is_cache_isolated<_Y>::value,
+			                                                      Ref_Count_Isolated<_Y, _Ref_Type>,
+			                                                      Ref_Count_Default<_Y, _Ref_Type>>::type(_rawPtr))
+		{
+			_enable_shared_from_this(*this, _rawPtr);
+		}
+
+		template <typename _Y>
+		shared_ptr(_Y* _rawPtr, cache_isolated_t)
+			//raw pointer constructor, reference count on a cache line of its own
+			: _myPtr(_rawPtr), _myRefC(new Ref_Count_Isolated<_Y, _Ref_Type>(_rawPtr))
 		{
 			_enable_shared_from_this(*this, _rawPtr);
 		}
@@ -441,14 +843,14 @@ namespace MyTR1 {
 		template <typename _D>
 		shared_ptr(::std::nullptr_t, _D _deleter)
 			//pointer and deleter constructor
-			: _myPtr(nullptr), _myRefC(new Ref_Count_Del<_T, _D>(nullptr, _deleter))
+			: _myPtr(nullptr), _myRefC(new Ref_Count_Del<_T, _D, _Ref_Type>(nullptr, _deleter))
 		{
 		}
 
 		template <typename _Y, typename _D>
 		shared_ptr(_Y* _rawPtr, _D _deleter)
 			//pointer and deleter constructor
-			: _myPtr(_rawPtr), _myRefC(new Ref_Count_Del<_Y, _D>(_rawPtr, _deleter))
+			: _myPtr(_rawPtr), _myRefC(new Ref_Count_Del<_Y, _D, _Ref_Type>(_rawPtr, _deleter))
 		{
 			_enable_shared_from_this(*this, _rawPtr);
 		}
@@ -457,10 +859,10 @@ namespace MyTR1 {
 		shared_ptr(::std::nullptr_t, _D _deleter, _Alloc _alloc)
 			: _myPtr(nullptr)
 		{
-			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc> _MyRefType;
+			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc, _Ref_Type> _MyRefType;
 			typename _Alloc::rebind<_MyRefType>::other _actual_Alloc(_alloc);
 			_MyRefType* _refPtr = _actual_Alloc.allocate(1);
-			_actual_Alloc.construct(_refPtr, _myPtr, _del, _alloc);
+			_actual_Alloc.construct(_refPtr, _myPtr, _deleter, _alloc);
 			_myRefC = _refPtr;
 		}
 
@@ -474,7 +876,7 @@ namespace MyTR1 {
 			//member pointer of shared_ptr is a pointer to the base class of 
 			//reference count object
 
-			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc> _MyRefType;
+			typedef Ref_Count_Del_Alloc<_T, _D, _Alloc, _Ref_Type> _MyRefType;
 			typename _Alloc::rebind<_MyRefType>::other _actual_Alloc(_alloc);
 			_MyRefType* _refPtr = _actual_Alloc.allocate(1);
 			_actual_Alloc.construct(_refPtr, _myPtr, _del, _alloc);
@@ -493,6 +895,8 @@ namespace MyTR1 {
 		shared_ptr(const shared_ptr<_U>& _other) noexcept
 			: _myPtr(_other._myPtr), _myRefC(_other._myRefC)
 		{
+			static_assert(is_same<typename shared_ptr<_U>::_Ref_Type, _Ref_Type>::value,
+				"no_weak_ref must agree between pointer types sharing a control block");
 			if (_myRefC)
 				_myRefC->_Increment();
 		}
@@ -522,14 +926,41 @@ namespace MyTR1 {
 		shared_ptr(shared_ptr<_U>&& _other) noexcept
 			: _myPtr(::std::move(_other._myPtr)), _myRefC(::std::move(_other._myRefC))
 		{
+			static_assert(is_same<typename shared_ptr<_U>::_Ref_Type, _Ref_Type>::value,
+				"no_weak_ref must agree between pointer types sharing a control block");
 			_other._myPtr = nullptr;
 			_other._myRefC = nullptr;
 		}
 
+		template <typename _Y, typename _D>
+		shared_ptr(unique_ptr<_Y, _D>&& _other)
+			//unique_ptr constructor, the deleter moves into the control block
+			: _myPtr(_other.get()), _myRefC(nullptr)
+		{
+			if (_myPtr) {
+				_myRefC = new Ref_Count_Del<_Y, _D, _Ref_Type>(_other.get(), ::std::forward<_D>(_other.get_deleter()));
+				_enable_shared_from_this(*this, _other.release());
+			}
+		}
+
+		template <typename _Y>
+		shared_ptr(unique_ptr<_Y, shareable_delete<_Y>>&& _other) noexcept
+			//unique_ptr constructor for make_unique_shareable, reuses the reserved control block
+			: _myPtr(_other.get()), _myRefC(nullptr)
+		{
+			if (_myPtr) {
+				_myRefC = _other.get_deleter()._Get_Ref_Count();
+				_other.get_deleter() = shareable_delete<_Y>();
+				_enable_shared_from_this(*this, _other.release());
+			}
+		}
+
 		template <typename _U>
 		shared_ptr(const shared_ptr<_U>& _other, _T* _rawPtr)
 			: _myPtr(_rawPtr), _myRefC(_other._myRefC)
 		{
+			static_assert(is_same<typename shared_ptr<_U>::_Ref_Type, _Ref_Type>::value,
+				"no_weak_ref must agree between pointer types sharing a control block");
 			if (_myRefC)
 				_myRefC->_Increment();
 			_enable_shared_from_this(*this, _rawPtr);
@@ -562,6 +993,12 @@ namespace MyTR1 {
 			return *this;
 		}
 
+		template <typename _Y, typename _D>
+		shared_ptr& operator=(unique_ptr<_Y, _D>&& _other) {
+			shared_ptr(::std::move(_other)).swap(*this);
+			return *this;
+		}
+
 
 		void swap(shared_ptr& _other) noexcept {
 
@@ -611,16 +1048,25 @@ namespace MyTR1 {
 		}
 
 		bool unique() const noexcept {
-			return (use_count == 1);
+			return (use_count() == 1);
 		}
 
 		explicit operator bool() const noexcept {
 			return (get() != nullptr);
 		}
 
+		// takes over one reference already held on _refC, for factories that
+		// build the control block themselves
+		static shared_ptr _Adopt(element_type* _rawPtr, _Ref_Type* _refC) noexcept {
+			shared_ptr _ret;
+			_ret._myPtr = _rawPtr;
+			_ret._myRefC = _refC;
+			return _ret;
+		}
+
 	private:
-		template <typename _T, typename _Y>
-		void _enable_shared_from_this(const shared_ptr<_T>& _sp, enable_shared_from_this<_Y>* _rawPtr) {
+		template <typename _Tx, typename _Y>
+		void _enable_shared_from_this(const shared_ptr<_Tx>& _sp, enable_shared_from_this<_Y>* _rawPtr) {
 			_rawPtr->_weak_this = _sp;
 		}
 
@@ -629,7 +1075,7 @@ namespace MyTR1 {
 		}
 
 		element_type* _myPtr;
-		Ref_Count* _myRefC;
+		_Ref_Type* _myRefC;
 	};
 
 	template <class _T>
@@ -643,6 +1089,9 @@ namespace MyTR1 {
 		template <typename _Tx, typename _Dx>
 		friend class unique_ptr;
 
+		static_assert(!no_weak_ref<typename remove_cv<_T>::type>::value,
+			"weak_ptr to a type specialized as no_weak_ref");
+
 	public:
 		typedef _T element_type;
 
@@ -670,6 +1119,8 @@ namespace MyTR1 {
 		weak_ptr(const shared_ptr<_U>& _other) noexcept
 			: _myPtr(_other._myPtr), _myRefC(_other._myRefC)
 		{
+			static_assert(!no_weak_ref<typename remove_cv<_U>::type>::value,
+				"weak_ptr from a shared_ptr to a type specialized as no_weak_ref");
 			if (_myRefC)
 				_myRefC->_Increment_Weak();
 		}
@@ -725,6 +1176,327 @@ namespace MyTR1 {
 		Ref_Count* _myRefC;
 	};
 
+	template <typename _T, typename... _Args>
+	shared_ptr<_T> make_shared(_Args&&... _args) {
+		typedef typename _Ref_Count_Obj_For<_T>::type _MyRefType;
+		_MyRefType* _refPtr = new _MyRefType(::std::forward<_Args>(_args)...);
+		shared_ptr<_T> _ret = shared_ptr<_T>::_Adopt(_refPtr->_Getptr(), _refPtr);
+		_ret._enable_shared_from_this(_ret, _ret._myPtr);
+		return _ret;
+	}
+
+	// a single word instead of shared_ptr's two: it points only at a control
+	// block holding the object inline, which is what make_shared creates
+	template <typename _T>
+	class compact_shared_ptr {
+		template <typename _Tx>
+		friend class compact_shared_ptr;
+
+		template <typename _Tx, typename... _Args>
+		friend compact_shared_ptr<_Tx> make_compact_shared(_Args&&... _args);
+
+	public:
+		typedef _T element_type;
+
+		constexpr compact_shared_ptr() noexcept
+			: _myRefC(nullptr)
+		{
+		}
+
+		constexpr compact_shared_ptr(::std::nullptr_t) noexcept
+			: _myRefC(nullptr)
+		{
+		}
+
+		compact_shared_ptr(const compact_shared_ptr& _other) noexcept
+			: _myRefC(_other._myRefC)
+		{
+			if (_myRefC)
+				_myRefC->_Increment();
+		}
+
+		compact_shared_ptr(compact_shared_ptr&& _other) noexcept
+			: _myRefC(_other._myRefC)
+		{
+			_other._myRefC = nullptr;
+		}
+
+		~compact_shared_ptr() {
+			if (_myRefC)
+				_myRefC->_Decrement();
+		}
+
+		compact_shared_ptr& operator=(const compact_shared_ptr& _other) noexcept {
+			compact_shared_ptr(_other).swap(*this);
+			return *this;
+		}
+
+		compact_shared_ptr& operator=(compact_shared_ptr&& _other) noexcept {
+			compact_shared_ptr(::std::move(_other)).swap(*this);
+			return *this;
+		}
+
+		operator shared_ptr<_T>() const noexcept {
+			if (!_myRefC)
+				return shared_ptr<_T>();
+			_myRefC->_Increment();
+			return shared_ptr<_T>::_Adopt(get(), _myRefC);
+		}
+
+		void swap(compact_shared_ptr& _other) noexcept {
+			::std::swap(_myRefC, _other._myRefC);
+		}
+
+		void reset() noexcept {
+			compact_shared_ptr().swap(*this);
+		}
+
+		element_type* get() const noexcept {
+			return _myRefC ? _myRefC->_Getptr() : nullptr;
+		}
+
+		typename ::std::add_lvalue_reference<_T>::type operator*() const noexcept {
+			return (*this->get());
+		}
+
+		element_type* operator->() const noexcept {
+			return (this->get());
+		}
+
+		long use_count() const noexcept {
+			if (!_myRefC)
+				return 0;
+			return _myRefC->_Get_Use_Count();
+		}
+
+		explicit operator bool() const noexcept {
+			return (_myRefC != nullptr);
+		}
+
+		// what try_compact does
+		static compact_shared_ptr _Try_Share(const shared_ptr<_T>& _other) noexcept {
+			compact_shared_ptr _ret;
+			Ref_Count_Obj<_T>* _refPtr = dynamic_cast<Ref_Count_Obj<_T>*>(_other._myRefC);
+			if (_refPtr && _refPtr->_Getptr() == _other._myPtr) {
+				_refPtr->_Increment();
+				_ret._myRefC = _refPtr;
+			}
+			return _ret;
+		}
+
+	private:
+		Ref_Count_Obj<_T>* _myRefC;
+	};
+
+	template <typename _T, typename... _Args>
+	compact_shared_ptr<_T> make_compact_shared(_Args&&... _args) {
+		shared_ptr<_T> _sp = make_shared<_T>(::std::forward<_Args>(_args)...);
+		compact_shared_ptr<_T> _ret;
+		_ret._myRefC = static_cast<Ref_Count_Obj<_T>*>(_sp._myRefC);
+		_sp._myPtr = nullptr;
+		_sp._myRefC = nullptr;
+		return _ret;
+	}
+
+	// shares ownership with _other if it came from make_shared and is not an
+	// aliasing pointer. any other shared_ptr has no inline block to point at,
+	// and gives an empty result
+	template <typename _T>
+	compact_shared_ptr<_T> try_compact(const shared_ptr<_T>& _other) noexcept {
+		return compact_shared_ptr<_T>::_Try_Share(_other);
+	}
+
+	template <typename _T>
+	compact_shared_ptr<_T> try_compact(const weak_ptr<_T>& _other) noexcept {
+		return compact_shared_ptr<_T>::_Try_Share(_other.lock());
+	}
+
+	// a non-owning view of a shared_ptr, meant to be passed down call chains by
+	// value: making, copying and dropping one never touches the reference count.
+	// it copies the pointer and the control block out of the owner, so the owner
+	// may be moved or relocated freely, but some owner has to keep the object
+	// alive while it is borrowed. a callee that keeps the object calls to_shared().
+	// define _MYTR1_DEBUG_BORROW to assert when the last owner goes away while
+	// the object is still borrowed
+	template <typename _T>
+	class borrowed_ptr {
+		template <typename _Tx>
+		friend class borrowed_ptr;
+
+	public:
+		typedef _T element_type;
+
+		template <typename _U>
+		borrowed_ptr(const shared_ptr<_U>& _owner) noexcept
+			: _myPtr(_owner._myPtr), _myRefC(_owner._myRefC)
+		{
+			static_assert(is_same<typename shared_ptr<_U>::_Ref_Type, typename shared_ptr<_T>::_Ref_Type>::value,
+				"no_weak_ref must agree between pointer types sharing a control block");
+			_Borrow();
+		}
+
+		//a temporary cannot be borrowed from
+		template <typename _U>
+		borrowed_ptr(const shared_ptr<_U>&&) = delete;
+
+		borrowed_ptr(const borrowed_ptr& _other) noexcept
+			: _myPtr(_other._myPtr), _myRefC(_other._myRefC)
+		{
+			_Borrow();
+		}
+
+		template <typename _U>
+		borrowed_ptr(const borrowed_ptr<_U>& _other) noexcept
+			: _myPtr(_other._myPtr), _myRefC(_other._myRefC)
+		{
+			static_assert(is_same<typename shared_ptr<_U>::_Ref_Type, typename shared_ptr<_T>::_Ref_Type>::value,
+				"no_weak_ref must agree between pointer types sharing a control block");
+			_Borrow();
+		}
+
+		~borrowed_ptr() {
+			_Return();
+		}
+
+		borrowed_ptr& operator=(const borrowed_ptr& _other) noexcept {
+			_other._Borrow();
+			_Return();
+			_myPtr = _other._myPtr;
+			_myRefC = _other._myRefC;
+			return *this;
+		}
+
+		element_type* get() const noexcept {
+			return _myPtr;
+		}
+
+		typename ::std::add_lvalue_reference<_T>::type operator*() const noexcept {
+			return (*this->get());
+		}
+
+		element_type* operator->() const noexcept {
+			return (this->get());
+		}
+
+		explicit operator bool() const noexcept {
+			return (get() != nullptr);
+		}
+
+		// an owning copy, costs the one increment borrowing saved
+		shared_ptr<_T> to_shared() const noexcept {
+			if (_myRefC)
+				_myRefC->_Increment();
+			return shared_ptr<_T>::_Adopt(_myPtr, _myRefC);
+		}
+
+	private:
+#ifdef _MYTR1_DEBUG_BORROW
+		void _Borrow() const noexcept {
+			if (_myRefC)
+				_myRefC->_Increment_Borrow();
+		}
+
+		void _Return() const noexcept {
+			if (_myRefC)
+				_myRefC->_Decrement_Borrow();
+		}
+#else
+		void _Borrow() const noexcept
+		{
+		}
+
+		void _Return() const noexcept
+		{
+		}
+#endif
+
+		element_type* _myPtr;
+		typename shared_ptr<_T>::_Ref_Type* _myRefC;
+	};
+
+	// a value wrapper whose copies share one object: reading is free, and
+	// write() copies the object first if anyone else still holds it.
+	// the object comes from make_cow or a unique_ptr, and no shared_ptr or
+	// weak_ptr to it is ever handed out, so its only owners are cow_ptrs. a
+	// count of 1 then means no other owner exists that could raise it
+	// concurrently, and its load synchronizes with the other owners' releases
+	template <typename _T>
+	class cow_ptr {
+		template <typename _Tx, typename... _Args>
+		friend cow_ptr<_Tx> make_cow(_Args&&... _args);
+
+		//shared_from_this() would hand out owners behind the count's back
+		static_assert(!is_base_of<enable_shared_from_this<_T>, _T>::value,
+			"enable_shared_from_this types cannot be copy-on-write");
+
+	public:
+		typedef _T element_type;
+
+		constexpr cow_ptr() noexcept
+			: _myPtr()
+		{
+		}
+
+		template <typename _D>
+		explicit cow_ptr(unique_ptr<_T, _D>&& _ptr)
+			: _myPtr(::std::move(_ptr))
+		{
+		}
+
+		const element_type* get() const noexcept {
+			return _myPtr.get();
+		}
+
+		const element_type& operator*() const noexcept {
+			return *get();
+		}
+
+		const element_type* operator->() const noexcept {
+			return get();
+		}
+
+		// mutable access, copying the object first if it is shared
+		element_type& write() {
+			assert(_myPtr);
+			if (!_myPtr.unique())
+				_myPtr = make_shared<_T>(static_cast<const _T&>(*_myPtr));
+			return *_myPtr;
+		}
+
+		bool unique() const noexcept {
+			return _myPtr.unique();
+		}
+
+		long use_count() const noexcept {
+			return _myPtr.use_count();
+		}
+
+		explicit operator bool() const noexcept {
+			return (get() != nullptr);
+		}
+
+		void swap(cow_ptr& _other) noexcept {
+			_myPtr.swap(_other._myPtr);
+		}
+
+		void reset() noexcept {
+			_myPtr.reset();
+		}
+
+	private:
+		explicit cow_ptr(shared_ptr<_T>&& _ptr) noexcept
+			: _myPtr(::std::move(_ptr))
+		{
+		}
+
+		shared_ptr<_T> _myPtr;
+	};
+
+	template <typename _T, typename... _Args>
+	cow_ptr<_T> make_cow(_Args&&... _args) {
+		return cow_ptr<_T>(make_shared<_T>(::std::forward<_Args>(_args)...));
+	}
+
 	template <typename _T, typename _D = default_delete<_T>>
 	class unique_ptr {
 		template <typename _Tx, typename _Dx>
@@ -861,6 +1633,18 @@ namespace MyTR1 {
 		deleter_type _myDeleter;
 	};
 
+	// a deleter that knows how many elements its array holds exposes it as
+	// size(), and unique_ptr<_T[]>::operator[] then checks indices against it
+	template <typename _D>
+	auto _Array_Index_Ok(const _D& _del, size_t _index, int) -> decltype(_del.size(), bool()) {
+		return _index < _del.size();
+	}
+
+	template <typename _D>
+	bool _Array_Index_Ok(const _D&, size_t, long) {
+		return true;
+	}
+
 	template <typename _T, typename _D>
 	class unique_ptr<_T[], _D> {
 	public:
@@ -954,6 +1738,7 @@ namespace MyTR1 {
 		}
 
 		element_type& operator[](size_t _index) const {
+			assert(_Array_Index_Ok(_myDeleter, _index, 0));
 			return get()[_index];
 		}
 
@@ -961,6 +1746,209 @@ namespace MyTR1 {
 		pointer _myPtr;
 		deleter_type _myDeleter;
 	};
+
+	// constructs the object inside a control block but hands it out uniquely
+	// owned; moving the result into a shared_ptr allocates nothing
+	template <typename _T, typename... _Args>
+	unique_ptr<_T, shareable_delete<_T>> make_unique_shareable(_Args&&... _args) {
+		typedef typename _Ref_Count_Obj_For<_T>::type _MyRefType;
+		_MyRefType* _refPtr = new _MyRefType(::std::forward<_Args>(_args)...);
+		return unique_ptr<_T, shareable_delete<_T>>(_refPtr->_Getptr(), shareable_delete<_T>(_refPtr));
+	}
+
+	// how inline_ptr moves and destroys the object it holds inline
+	template <typename _Base>
+	struct _Inline_Ops {
+		//move-constructs at _dst and destroys _src
+		_Base* (*_relocate)(void* _src, void* _dst) noexcept;
+		//same, but onto the heap
+		_Base* (*_to_heap)(void* _src);
+		void (*_destroy)(void* _obj) noexcept;
+	};
+
+	template <typename _Base, typename _D>
+	struct _Inline_Ops_For {
+		static _Base* _Relocate(void* _src, void* _dst) noexcept {
+			_D* _from = static_cast<_D*>(_src);
+			_D* _to = ::new (_dst) _D(::std::move(*_from));
+			_from->~_D();
+			return _to;
+		}
+
+		static _Base* _To_Heap(void* _src) {
+			_D* _from = static_cast<_D*>(_src);
+			_D* _to = new _D(::std::move(*_from));
+			_from->~_D();
+			return _to;
+		}
+
+		static void _Destroy(void* _obj) noexcept {
+			static_cast<_D*>(_obj)->~_D();
+		}
+
+		static const _Inline_Ops<_Base> _Ops;
+	};
+
+	template <typename _Base, typename _D>
+	const _Inline_Ops<_Base> _Inline_Ops_For<_Base, _D>::_Ops = {
+		&_Inline_Ops_For<_Base, _D>::_Relocate,
+		&_Inline_Ops_For<_Base, _D>::_To_Heap,
+		&_Inline_Ops_For<_Base, _D>::_Destroy
+	};
+
+	// sole ownership of a polymorphic object like unique_ptr<_Base>, but a
+	// derived object that fits in _N bytes and moves without throwing is built
+	// in place instead of on the heap. larger ones fall back to the heap, where
+	// _Base needs a virtual destructor as with unique_ptr
+	template <typename _Base, size_t _N = 64>
+	class inline_ptr {
+	public:
+		typedef _Base element_type;
+
+		constexpr inline_ptr() noexcept
+			: _myPtr(nullptr), _myOps(nullptr)
+		{
+		}
+
+		constexpr inline_ptr(::std::nullptr_t) noexcept
+			: inline_ptr()
+		{
+		}
+
+		//takes ownership of a heap object
+		explicit inline_ptr(_Base* _ptr) noexcept
+			: _myPtr(_ptr), _myOps(nullptr)
+		{
+		}
+
+		inline_ptr(inline_ptr&& _other) noexcept
+			: _myPtr(nullptr), _myOps(nullptr)
+		{
+			_Take(_other);
+		}
+
+		inline_ptr(const inline_ptr&) = delete;
+
+		~inline_ptr() {
+			reset();
+		}
+
+		inline_ptr& operator=(inline_ptr&& _other) noexcept {
+			if (this != &_other) {
+				reset();
+				_Take(_other);
+			}
+			return *this;
+		}
+
+		inline_ptr& operator=(::std::nullptr_t) noexcept {
+			reset();
+			return *this;
+		}
+
+		inline_ptr& operator=(const inline_ptr&) = delete;
+
+		template <typename _D, typename... _Args>
+		_D& emplace(_Args&&... _args) {
+			reset();
+			return _Emplace<_D>(_Fits<_D>(), ::std::forward<_Args>(_args)...);
+		}
+
+		_Base* get() const noexcept {
+			return _myPtr;
+		}
+
+		typename add_lvalue_reference<_Base>::type operator*() const {
+			return *get();
+		}
+
+		_Base* operator->() const noexcept {
+			return get();
+		}
+
+		explicit operator bool() const noexcept {
+			return (get() != nullptr);
+		}
+
+		bool is_inline() const noexcept {
+			return (_myOps != nullptr);
+		}
+
+		// gives up ownership of a heap object, moving an inline one to the heap first
+		_Base* release() {
+			_Base* _ptr = _myOps ? _myOps->_to_heap(_myStorage) : _myPtr;
+			_myPtr = nullptr;
+			_myOps = nullptr;
+			return _ptr;
+		}
+
+		void reset() noexcept {
+			if (_myOps)
+				_myOps->_destroy(_myStorage);
+			else
+				delete _myPtr;
+			_myPtr = nullptr;
+			_myOps = nullptr;
+		}
+
+		void reset(_Base* _ptr) noexcept {
+			reset();
+			_myPtr = _ptr;
+		}
+
+		void swap(inline_ptr& _other) noexcept {
+			inline_ptr _tmp(::std::move(_other));
+			_other = ::std::move(*this);
+			*this = ::std::move(_tmp);
+		}
+
+	private:
+		template <typename _D>
+		struct _Fits : integral_constant<bool,
+			sizeof(_D) <= _N
+			&& alignof(_D) <= alignof(::std::max_align_t)
+			&& is_nothrow_move_constructible<_D>::value>
+		{
+		};
+
+		//only the branch taken is instantiated, so types that cannot move, or
+		//do not fit, never see the inline one
+		template <typename _D, typename... _Args>
+		_D& _Emplace(true_type, _Args&&... _args) {
+			_D* _obj = ::new (static_cast<void*>(_myStorage)) _D(::std::forward<_Args>(_args)...);
+			_myOps = &_Inline_Ops_For<_Base, _D>::_Ops;
+			_myPtr = _obj;
+			return *_obj;
+		}
+
+		template <typename _D, typename... _Args>
+		_D& _Emplace(false_type, _Args&&... _args) {
+			_D* _obj = new _D(::std::forward<_Args>(_args)...);
+			_myPtr = _obj;
+			return *_obj;
+		}
+
+		void _Take(inline_ptr& _other) noexcept {
+			if (_other._myOps)
+				_myPtr = _other._myOps->_relocate(_other._myStorage, _myStorage);
+			else
+				_myPtr = _other._myPtr;
+			_myOps = _other._myOps;
+			_other._myPtr = nullptr;
+			_other._myOps = nullptr;
+		}
+
+		alignas(::std::max_align_t) unsigned char _myStorage[_N];
+		_Base* _myPtr;
+		const _Inline_Ops<_Base>* _myOps;
+	};
+
+	template <typename _Base, size_t _N, typename _D, typename... _Args>
+	inline_ptr<_Base, _N> make_inline(_Args&&... _args) {
+		inline_ptr<_Base, _N> _ret;
+		_ret.template emplace<_D>(::std::forward<_Args>(_args)...);
+		return _ret;
+	}
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+// memory taken by, and the time to iterate over, a large vector of pointers
+// to small objects: shared_ptr over new, shared_ptr from make_shared, and
+// compact_shared_ptr.
+//
+//   g++ -O2 -std=c++17 -I.. compact_shared.cpp -o compact_shared
+//   ./compact_shared [elements]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "MySmartPtr.h"
+
+using MyTR1::compact_shared_ptr;
+using MyTR1::shared_ptr;
+
+//bytes requested from operator new, a lower bound on what the heap hands out
+static size_t g_requested = 0;
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+	g_requested += size;
+	++g_allocations;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+struct Point {
+	long x, y;
+};
+
+template <typename Ptr, typename Make>
+static void run(const char* name, size_t count, Make make) {
+	size_t requested = g_requested, allocations = g_allocations;
+	std::vector<Ptr> v;
+	v.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+		v.push_back(make(static_cast<long>(i)));
+	requested = g_requested - requested;
+	allocations = g_allocations - allocations;
+
+	const int passes = 20;
+	long sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; ++pass)
+		for (const Ptr& p : v)
+			sum += p->x;
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::printf("%-22s %2zu B/pointer %6.1f B/element %4.2f allocs/element %6.2f ns/element (%ld)\n",
+		name, sizeof(Ptr), double(requested) / count, double(allocations) / count,
+		elapsed.count() / (double(count) * passes), sum);
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4000000;
+
+	run<shared_ptr<Point>>("shared_ptr(new)", count,
+		[](long i) { return shared_ptr<Point>(new Point{ i, i }); });
+	run<shared_ptr<Point>>("make_shared", count,
+		[](long i) { return MyTR1::make_shared<Point>(Point{ i, i }); });
+	run<compact_shared_ptr<Point>>("make_compact_shared", count,
+		[](long i) { return MyTR1::make_compact_shared<Point>(Point{ i, i }); });
+	return 0;
+}
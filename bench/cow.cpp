@@ -0,0 +1,83 @@
+// cost of taking many copies of a large value, as deep copies and as
+// cow_ptr copies, and what writing to a fraction of the copies adds back.
+//
+//   g++ -O2 -std=c++17 -I.. cow.cpp -o cow
+//   ./cow [copies] [elements per value] [percent of copies written]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "MySmartPtr.h"
+
+using MyTR1::cow_ptr;
+
+static size_t g_requested = 0;
+
+void* operator new(size_t size) {
+	g_requested += size;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+typedef std::vector<double> Value;
+
+struct Result {
+	double copyNs;
+	double writeNs;
+	size_t bytes;
+};
+
+template <typename Copy, typename Write>
+static Result run(size_t copies, size_t percent, Copy copy, Write write) {
+	Result r;
+	size_t requested = g_requested;
+	auto start = std::chrono::steady_clock::now();
+	auto all = copy(copies);
+	auto copied = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < copies; ++i)
+		if (i % 100 < percent)
+			write(all[i], i);
+	auto written = std::chrono::steady_clock::now();
+	r.copyNs = std::chrono::duration<double, std::nano>(copied - start).count() / copies;
+	r.writeNs = std::chrono::duration<double, std::nano>(written - copied).count() / copies;
+	r.bytes = g_requested - requested;
+	return r;
+}
+
+static void print(const char* name, const Result& r, size_t copies) {
+	std::printf("%-12s %10.1f ns/copy %10.1f ns/copy writing %10.1f KiB/copy\n",
+		name, r.copyNs, r.writeNs, r.bytes / 1024.0 / copies);
+}
+
+int main(int argc, char** argv) {
+	size_t copies = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+	size_t elements = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4096;
+	size_t percent = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10;
+
+	Value original(elements, 1.0);
+	cow_ptr<Value> shared = MyTR1::make_cow<Value>(original);
+
+	Result deep = run(copies, percent,
+		[&](size_t n) { return std::vector<Value>(n, original); },
+		[](Value& v, size_t i) { v[0] = double(i); });
+	Result cow = run(copies, percent,
+		[&](size_t n) { return std::vector<cow_ptr<Value>>(n, shared); },
+		[](cow_ptr<Value>& v, size_t i) { v.write()[0] = double(i); });
+
+	std::printf("%zu copies of %zu doubles, %zu%% of them written\n", copies, elements, percent);
+	print("deep copy", deep, copies);
+	print("cow_ptr", cow, copies);
+	return 0;
+}
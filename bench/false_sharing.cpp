@@ -0,0 +1,129 @@
+// copies shared_ptrs from several threads, each thread touching only its own
+// pointer, with and without cache-line-isolated control blocks.
+//
+//   g++ -O2 -std=c++17 -pthread -I.. false_sharing.cpp -o false_sharing
+//   ./false_sharing [threads] [copies per thread]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "MySmartPtr.h"
+
+using MyTR1::shared_ptr;
+
+struct Hot {
+	long value;
+};
+
+//the last block handed out by operator new, i.e. the control block of the
+//shared_ptr just constructed from an existing object
+static void* g_last = nullptr;
+
+void* operator new(size_t size) {
+	if (void* p = std::malloc(size ? size : 1))
+		return g_last = p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+	size_t a = static_cast<size_t>(align);
+	if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a))
+		return g_last = p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+	std::free(p);
+}
+
+//allocates all objects first and then their control blocks, so consecutive
+//blocks are not separated by objects, and records where each block went
+static std::vector<shared_ptr<Hot>> make(unsigned count, bool isolated, std::vector<std::uintptr_t>& blocks) {
+	std::vector<shared_ptr<Hot>> ptrs;
+	std::vector<Hot*> objects;
+	ptrs.reserve(count);
+	objects.reserve(count);
+	blocks.reserve(count);
+	for (unsigned i = 0; i < count; ++i)
+		objects.push_back(new Hot());
+	for (unsigned i = 0; i < count; ++i) {
+		if (isolated)
+			ptrs.push_back(shared_ptr<Hot>(objects[i], MyTR1::cache_isolated));
+		else
+			ptrs.push_back(shared_ptr<Hot>(objects[i]));
+		blocks.push_back(reinterpret_cast<std::uintptr_t>(g_last));
+	}
+	return ptrs;
+}
+
+//how many blocks start on a cache line where another thread's block also starts
+static unsigned shared_lines(const std::vector<std::uintptr_t>& blocks) {
+	unsigned count = 0;
+	for (size_t i = 0; i < blocks.size(); ++i) {
+		for (size_t j = 0; j < blocks.size(); ++j) {
+			if (i != j && blocks[i] / MyTR1::_Cache_Line_Size == blocks[j] / MyTR1::_Cache_Line_Size) {
+				++count;
+				break;
+			}
+		}
+	}
+	return count;
+}
+
+static std::atomic<long> sink(0);
+
+static double run(const std::vector<shared_ptr<Hot>>& ptrs, long copies) {
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ptrs.size(); ++i) {
+		threads.emplace_back([&ptrs, i, copies] {
+			const shared_ptr<Hot>& mine = ptrs[i];
+			long sum = 0;
+			for (long n = 0; n < copies; ++n) {
+				shared_ptr<Hot> copy(mine);
+				sum += copy->value;
+			}
+			sink += sum;
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / copies;
+}
+
+int main(int argc, char** argv) {
+	unsigned threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+	long copies = argc > 2 ? std::atol(argv[2]) : 10000000;
+	if (threads == 0)
+		threads = 4;
+
+	std::vector<std::uintptr_t> sharedBlocks, isolatedBlocks;
+	std::vector<shared_ptr<Hot>> shared = make(threads, false, sharedBlocks);
+	std::vector<shared_ptr<Hot>> isolated = make(threads, true, isolatedBlocks);
+
+	std::printf("%u threads, %ld copies each\n", threads, copies);
+	std::printf("default blocks:  %8.2f ns per copy, %u of %u blocks share a cache line\n",
+		run(shared, copies), shared_lines(sharedBlocks), threads);
+	std::printf("isolated blocks: %8.2f ns per copy, %u of %u blocks share a cache line\n",
+		run(isolated, copies), shared_lines(isolatedBlocks), threads);
+	return 0;
+}
@@ -0,0 +1,154 @@
+// time and peak stack depth of dropping the root of a long shared_ptr chain,
+// a deep shared_ptr tree and a long unique_ptr chain, with recursive
+// destruction and with iterative_teardown / deferred_delete.
+//
+//   g++ -O2 -std=c++17 -I.. teardown.cpp -o teardown
+//   ./teardown [chain nodes] [tree depth]
+//
+// recursive destruction of a chain needs roughly the reported bytes per node
+// of stack: raise the stack limit (ulimit -s) before passing long chains
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "MySmartPtr.h"
+
+using MyTR1::shared_ptr;
+using MyTR1::unique_ptr;
+
+static std::uintptr_t g_lowest;
+
+static void note_depth() {
+	volatile char here = 0;
+	std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(&here);
+	if (addr < g_lowest)
+		g_lowest = addr;
+}
+
+template <bool Iterative>
+struct Node {
+	shared_ptr<Node> next;
+
+	~Node() {
+		note_depth();
+	}
+};
+
+template <bool Iterative>
+struct TreeNode {
+	shared_ptr<TreeNode> left, right;
+
+	~TreeNode() {
+		note_depth();
+	}
+};
+
+template <bool Iterative>
+struct UniqueNode {
+	typedef typename MyTR1::conditional<Iterative, MyTR1::deferred_delete<UniqueNode>,
+		MyTR1::default_delete<UniqueNode>>::type Deleter;
+
+	unique_ptr<UniqueNode, Deleter> next;
+
+	~UniqueNode() {
+		note_depth();
+	}
+};
+
+namespace MyTR1 {
+	template <>
+	struct iterative_teardown<Node<true>> : true_type
+	{
+	};
+
+	template <>
+	struct iterative_teardown<TreeNode<true>> : true_type
+	{
+	};
+}
+
+//times dropping root and reports the stack it took below this frame
+template <typename Ptr>
+static void measure(const char* name, size_t count, Ptr& root) {
+	volatile char base = 0;
+	g_lowest = reinterpret_cast<std::uintptr_t>(&base);
+	auto start = std::chrono::steady_clock::now();
+	root.reset();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	size_t depth = reinterpret_cast<std::uintptr_t>(&base) - g_lowest;
+
+	std::printf("%-32s %8.2f ns/node %10zu B peak stack %8.1f B/node\n",
+		name, elapsed.count() / count, depth, double(depth) / count);
+}
+
+template <bool Iterative, bool MakeShared>
+static void chain(const char* name, size_t count) {
+	typedef Node<Iterative> N;
+	shared_ptr<N> head;
+	for (size_t i = 0; i < count; ++i) {
+		shared_ptr<N> node = MakeShared ? MyTR1::make_shared<N>() : shared_ptr<N>(new N());
+		node->next = head;
+		head = node;
+	}
+	measure(name, count, head);
+}
+
+template <bool Iterative>
+static shared_ptr<TreeNode<Iterative>> build_tree(int depth) {
+	if (depth == 0)
+		return shared_ptr<TreeNode<Iterative>>();
+	shared_ptr<TreeNode<Iterative>> node = MyTR1::make_shared<TreeNode<Iterative>>();
+	node->left = build_tree<Iterative>(depth - 1);
+	node->right = build_tree<Iterative>(depth - 1);
+	return node;
+}
+
+template <bool Iterative>
+static void tree(const char* name, int depth) {
+	shared_ptr<TreeNode<Iterative>> root = build_tree<Iterative>(depth);
+	measure(name, (size_t(1) << depth) - 1, root);
+}
+
+template <bool Iterative>
+static void unique_chain(const char* name, size_t count) {
+	typedef UniqueNode<Iterative> N;
+	typedef typename N::Deleter Deleter;
+	unique_ptr<N, Deleter> head;
+	for (size_t i = 0; i < count; ++i) {
+		unique_ptr<N, Deleter> node(new N());
+		node->next = std::move(head);
+		head = std::move(node);
+	}
+	measure(name, count, head);
+}
+
+//torn down while statics are destroyed, after the thread_local state of
+//this thread is gone
+static shared_ptr<Node<true>> g_atExit;
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+	int depth = argc > 2 ? std::atoi(argv[2]) : 18;
+
+	std::printf("chains of %zu nodes\n", count);
+	chain<false, false>("recursive, new", count);
+	chain<false, true>("recursive, make_shared", count);
+	chain<true, false>("iterative, new", count);
+	chain<true, true>("iterative, make_shared", count);
+	unique_chain<false>("recursive, unique_ptr", count);
+	unique_chain<true>("deferred_delete, unique_ptr", count);
+
+	std::printf("trees of depth %d\n", depth);
+	tree<false>("recursive", depth);
+	tree<true>("iterative", depth);
+
+	for (size_t i = 0; i < count; ++i) {
+		shared_ptr<Node<true>> node = MyTR1::make_shared<Node<true>>();
+		node->next = g_atExit;
+		g_atExit = node;
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+// shares an object between two processes through a segment on tmpfs. the
+// child maps the segment again at a different address, reads what the parent
+// stored, and publishes an object of its own through root().
+//
+//   g++ -std=c++17 -I.. mapped_fork.cpp -o mapped_fork && ./mapped_fork
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "MyMappedPtr.h"
+
+using MyTR1::make_mapped_shared;
+using MyTR1::mapped_segment;
+using MyTR1::mapped_shared_ptr;
+
+struct Message {
+	int values[1000];
+};
+
+static int child(const char* path, const void* parentBase) {
+	//occupy some address space so the second mapping lands elsewhere
+	::mmap(nullptr, 1 << 22, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	mapped_segment seg(path, 0);
+	if (seg.base() == parentBase)
+		std::printf("child: mapped at the same address, offsets not exercised\n");
+
+	mapped_shared_ptr<Message> msg = seg.root<Message>();
+	if (!msg || msg->values[999] != 999 || msg.use_count() != 3)
+		return 1;
+
+	mapped_shared_ptr<Message> reply = make_mapped_shared<Message>(seg);
+	reply->values[0] = 42;
+	seg.root<Message>() = reply;
+	return 0;
+}
+
+int main() {
+	const char* path = "/dev/shm/mytr1_mapped_fork";
+	::unlink(path);
+
+	int status = 1;
+	{
+		mapped_segment seg(path, 1 << 20);
+		mapped_shared_ptr<Message> msg = make_mapped_shared<Message>(seg);
+		for (int i = 0; i < 1000; ++i)
+			msg->values[i] = i;
+		seg.root<Message>() = msg;
+
+		pid_t pid = ::fork();
+		if (pid == 0) {
+			//_exit skips destructors, so the child's pointers live in child()
+			std::fflush(stdout);
+			::_exit(child(path, seg.base()));
+		}
+		::waitpid(pid, &status, 0);
+
+		//the child dropped its references, and its reply replaced ours in root()
+		bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0
+			&& msg.use_count() == 1
+			&& seg.root<Message>()->values[0] == 42
+			&& seg.root<Message>().use_count() == 1;
+		status = ok ? 0 : 1;
+
+		seg.root<Message>().reset();
+	}
+	::unlink(path);
+
+	std::printf(status == 0 ? "ok\n" : "FAILED\n");
+	return status;
+}